@@ -0,0 +1,135 @@
+#include "batch.h"
+
+#include <libconfig.h++>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    typedef std::chrono::steady_clock BatchClock;
+
+    double elapsed_ms(BatchClock::time_point since)
+    {
+        return std::chrono::duration<double, std::milli>(BatchClock::now() - since).count();
+    }
+}
+
+/**
+ * @param config_path path to config file
+ * @param get_frame source of frames; returns an empty frame at the end. As
+ *        with Detector, the first frame only gives the frame size.
+ * @throws libconfig::ConfigException if the config file cannot be read
+ */
+BatchDetector::BatchDetector(std::string config_path, std::function<cv::Mat()> get_frame)
+    : get_frame(get_frame)
+{
+    int threads = 0;
+    libconfig::Config cfg;
+    try
+    {
+        cfg.readFile(config_path.c_str());
+        cfg.lookupValue("batch.threads", threads);
+        cfg.lookupValue("batch.depth", depth);
+    }
+    catch(...)
+    {
+        std::cerr << "Invalid config file" << std::endl;
+        throw;
+    }
+    if (threads < 1) threads = std::max(1, (int)std::thread::hardware_concurrency());
+    if (depth < 1) depth = 2 * threads;
+
+    pool = new TaskPool(threads);
+
+    cv::Mat first = get_frame();
+    detector = new Detector(config_path, [first]() { return first; });
+    for (int i = 0; i < depth; i++)
+    {
+        workers.push_back(new Detector(config_path, [first]() { return first; }, true));
+    }
+    frames.resize(depth);
+    next_frames.resize(depth);
+}
+
+BatchDetector::~BatchDetector()
+{
+    for (Detector *worker : workers)
+    {
+        delete worker;
+    }
+    delete detector;
+    delete pool;
+}
+
+/**
+ * Detects the lane in every remaining frame
+ * @param callback called with the lane after each frame, in frame order
+ */
+void BatchDetector::run(std::function<void(const Lane &lane)> callback)
+{
+    auto begin = BatchClock::now();
+    int count = read(frames);
+    while (count > 0)
+    {
+        // Preprocess this batch while reading the next
+        auto measure_begin = BatchClock::now();
+        int next = 0;
+        pool->parallelFor(count + 1, [&](int k) {
+            if (k == count)
+            {
+                next = read(next_frames);
+            }
+            else
+            {
+                workers[k]->prepare(frames[k]);
+            }
+        });
+        stats.measure_ms += elapsed_ms(measure_begin);
+
+        auto commit_begin = BatchClock::now();
+        for (int k = 0; k < count; k++)
+        {
+            detector->commit(*workers[k]);
+            stats.frames++;
+            callback(detector->getLane());
+        }
+        stats.commit_ms += elapsed_ms(commit_begin);
+
+        frames.swap(next_frames);
+        count = next;
+    }
+    stats.wall_ms += elapsed_ms(begin);
+}
+
+/**
+ * Reads up to depth frames
+ * @param batch receives the frames
+ * @return frames read; fewer than depth at the end of the input
+ */
+int BatchDetector::read(std::vector<cv::Mat> &batch)
+{
+    auto begin = BatchClock::now();
+    int count = 0;
+    while (count < depth && !ended)
+    {
+        batch[count] = get_frame();
+        ended = batch[count].empty();
+        if (!ended) count++;
+    }
+    stats.read_ms += elapsed_ms(begin);
+    return count;
+}
+
+/**
+ * @return the detector that filters the lane; its lane, hits and search
+ *         statistics are those of the last committed frame
+ */
+const Detector &BatchDetector::getDetector() const { return *detector; }
+
+int BatchDetector::getThreads() const { return pool->getThreads(); }
+
+int BatchDetector::getDepth() const { return depth; }
+
+BatchDetector::Stats BatchDetector::getStats() const { return stats; }
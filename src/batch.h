@@ -0,0 +1,68 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "opencv2/opencv.hpp"
+#include "detector.h"
+#include "taskpool.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+/**
+ * Offline detection of recorded frames with many frames in flight.
+ *
+ * A frame depends on the frames before it only through where it is
+ * searched; its birdseye mask does not depend on the lane. Frames are taken
+ * in batches of batch.depth. Every frame of a batch is preprocessed in
+ * parallel, each by its own worker Detector (see Detector::prepare()), while
+ * the next batch is read. A sequential Detector then searches the kept masks
+ * around its lane and fits and filters the hits, frame by frame (see
+ * Detector::commit()), so the lanes are the same as with Detector::step().
+ * Thresholding and warping dominate a frame; the search reads a few hundred
+ * mask pixels, so the sequential stage is short and throughput grows with
+ * the threads until reading frames or the search itself becomes the limit.
+ * In sparse mode there is no preprocessing to take off the sequential stage
+ * and nothing is gained. Configured by the `batch` section of the config
+ * file. Frames are the unit of parallelism, so with more than one
+ * thread the caller should turn OpenCV's own threads off
+ * (cv::setNumThreads(1)).
+ */
+class BatchDetector
+{
+public:
+    struct Stats
+    {
+        uint64_t frames;   // frames committed
+        double read_ms;    // time spent reading frames
+        double measure_ms; // wall time of the parallel stage, reading included
+        double commit_ms;  // wall time of the sequential stage
+        double wall_ms;    // time spent in run()
+    };
+
+    BatchDetector(std::string config_path, std::function<cv::Mat()> get_frame);
+    virtual ~BatchDetector();
+
+    void run(std::function<void(const Lane &lane)> callback);
+
+    const Detector &getDetector() const;
+    int getThreads() const;
+    int getDepth() const;
+    Stats getStats() const;
+
+private:
+    std::function<cv::Mat()> get_frame;
+    int depth = 0;     // frames per batch
+    TaskPool *pool = nullptr;
+    Detector *detector = nullptr;     // filters the lane in frame order
+    std::vector<Detector*> workers;   // one per frame of a batch
+    std::vector<cv::Mat> frames;      // frames of the batch being measured
+    std::vector<cv::Mat> next_frames; // frames of the batch being read
+    bool ended = false;               // get_frame() has returned an empty frame
+    Stats stats = {};
+
+    int read(std::vector<cv::Mat> &batch);
+};
+
+#endif
@@ -0,0 +1,323 @@
+/**
+ * bench_detect.cpp
+ * Replays frames through Detector as fast as possible (no rate limit) and
+ * reports frames/s and per-stage latency distributions for every combination
+ * of resolution, row_step/col_step, detector.threshold, lane.n and
+ * detector.pyramid.
+ *
+ * Every other setting (preprocess mode, sparse, ...) comes from the config
+ * file, so two versions can be compared by running both on the same config
+ * and diffing the output.
+ *
+ * Usage: bench_detect <config file> [video file or -] [frames] [csv|json] [name=value ...]
+ *   video file: frames are decoded once into memory, then resized per run;
+ *               "-" (default) renders frames with RoadGenerator
+ *   frames:     frames timed per run (default 200)
+ *   name=value: RoadGenerator settings for synthetic frames, e.g. curvature=0.1
+ *
+ * With synthetic frames each run also reports how far the detected lane lines
+ * are from the ground truth (mean absolute error over all rows, in pixels).
+ * reads is the mean number of pixels the search probed per frame, which is
+ * what detector.adaptive saves. vs_single_px is how far the lane of a
+ * pyramid run ends up from the lane of the single-level run (pyramid 0) with
+ * the same settings, in the same units as the ground truth error.
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <unistd.h>
+#include <libconfig.h++>
+
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+#include "metrics.h"
+#include "polynomial.h"
+#include "roadgen.h"
+
+using namespace cv;
+
+#define WARMUP_FRAMES 10
+#define SYNTHETIC_FRAMES 16 // distinct noise patterns replayed per resolution
+
+struct Step
+{
+    int row;
+    int col;
+};
+
+struct Stage
+{
+    const char *name;
+    Histogram &histogram;
+};
+
+/**
+ * Sets an integer setting, creating it if the config does not have it yet
+ * @param cfg config to modify
+ * @param group path of the enclosing group, e.g. "detector"
+ * @param name name of the setting inside the group
+ */
+void set_int(libconfig::Config &cfg, const char *group, const char *name, int value)
+{
+    libconfig::Setting &parent = cfg.lookup(group);
+    if (!parent.exists(name))
+    {
+        parent.add(name, libconfig::Setting::TypeInt);
+    }
+    parent[name] = value;
+}
+
+/**
+ * @return mean absolute difference between a fitted and a true lane line, in pixels
+ */
+double lane_error(const double *fit, int fit_degree, const double *truth, int truth_degree, int height)
+{
+    double sum = 0;
+    for (int y = 0; y < height; y++)
+    {
+        sum += std::abs(polynomial(fit, fit_degree, y) - polynomial(truth, truth_degree, y));
+    }
+    return sum / height;
+}
+
+/**
+ * @return which preprocessing path the config selects
+ */
+string detector_mode(const libconfig::Config &cfg)
+{
+    string mode = "warp";
+    if (cfg.exists("detector.sparse") && (bool)cfg.lookup("detector.sparse")) mode = "sparse";
+    else if (cfg.exists("detector.preprocess")) mode = cfg.lookup("detector.preprocess").c_str();
+    if (cfg.exists("detector.adaptive") && (bool)cfg.lookup("detector.adaptive")) mode += "+adaptive";
+    return mode;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <config file> [video file or -] [frames] [csv|json] [name=value ...]" << endl;
+        return 0;
+    }
+    string config_path(argv[1]);
+    string video_path = argc > 2 ? argv[2] : "-";
+    int frames = argc > 3 ? atoi(argv[3]) : 200;
+    bool json = argc > 4 && string(argv[4]) == "json";
+
+    RoadGenerator::Params road;
+    for (int i = 5; i < argc; i++)
+    {
+        if (!RoadGenerator::parse(road, argv[i]))
+        {
+            cerr << "Unknown setting " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    libconfig::Config cfg;
+    try
+    {
+        cfg.readFile(config_path.c_str());
+    }
+    catch(...)
+    {
+        cerr << "Invalid config file" << endl;
+        return 1;
+    }
+    string mode = detector_mode(cfg);
+
+    // Decode up front so the codec is not part of the measurement
+    std::vector<Mat> source;
+    if (video_path != "-")
+    {
+        VideoCapture cap(video_path);
+        Mat frame;
+        while ((int)source.size() < frames && cap.read(frame))
+        {
+            source.push_back(frame.clone());
+        }
+        if (source.empty())
+        {
+            cerr << "Could not read frames from " << video_path << endl;
+            return 1;
+        }
+    }
+
+    char tmp_path[] = "/tmp/bench_detect_XXXXXX";
+    int fd = mkstemp(tmp_path);
+    if (fd < 0)
+    {
+        cerr << "Could not create temporary config file" << endl;
+        return 1;
+    }
+    close(fd);
+
+    Metrics &metrics = Metrics::instance();
+    metrics.enable(true);
+    Histogram &radius_ns = metrics.histogram("bench.turning_radius_ns");
+    Histogram &reads = metrics.histogram("detector.pixel_reads");
+    Stage stages[] = {
+        {"preprocess", metrics.histogram("detector.preprocess_ns")},
+        {"coarse", metrics.histogram("detector.coarse_ns")},
+        {"search", metrics.histogram("detector.search_ns")},
+        {"fit", metrics.histogram("detector.fit_ns")},
+        {"radius", radius_ns},
+        {"update", metrics.histogram("detector.update_ns")},
+    };
+
+    const Size sizes[] = {Size(320, 240), Size(640, 480), Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const Step steps[] = {{20, 4}, {10, 2}, {5, 1}};
+    const int thresholds[] = {15, 30};
+    const int degrees[] = {2, 3, 4};
+    const int pyramids[] = {0, 1, 2};
+
+    if (!json)
+    {
+        cout << "mode,width,height,row_step,col_step,threshold,n,pyramid,frames,fps,left_err_px,right_err_px,vs_single_px,reads";
+        for (const Stage &stage : stages)
+        {
+            cout << "," << stage.name << "_mean_us," << stage.name << "_p50_us,"
+                 << stage.name << "_p95_us," << stage.name << "_p99_us," << stage.name << "_max_us";
+        }
+        cout << endl;
+    }
+
+    for (const Size &size : sizes)
+    {
+        std::vector<Mat> replay;
+        road.width = size.width;
+        road.height = size.height;
+        RoadGenerator generator(config_path, road);
+        if (source.empty())
+        {
+            for (int i = 0; i < SYNTHETIC_FRAMES; i++)
+            {
+                replay.push_back(generator.render(i));
+            }
+        }
+        for (const Mat &frame : source)
+        {
+            replay.push_back(Mat());
+            resize(frame, replay.back(), size);
+        }
+
+        for (const Step &step : steps)
+        {
+            for (int threshold : thresholds)
+            {
+                for (int degree : degrees)
+                {
+                    double single_left[LANE_MAX_DEGREE];
+                    double single_right[LANE_MAX_DEGREE];
+                    for (int pyramid : pyramids)
+                    {
+                        try
+                        {
+                            set_int(cfg, "detector", "row_step", step.row);
+                            set_int(cfg, "detector", "col_step", step.col);
+                            set_int(cfg, "detector", "threshold", threshold);
+                            set_int(cfg, "lane", "n", degree);
+                            set_int(cfg, "detector", "pyramid", pyramid);
+                            cfg.writeFile(tmp_path);
+                        }
+                        catch(...)
+                        {
+                            cerr << "Invalid config file" << endl;
+                            unlink(tmp_path);
+                            return 1;
+                        }
+
+                        size_t next = 0;
+                        Detector detector(tmp_path, [&replay, &next]() {
+                            return replay[next++ % replay.size()];
+                        });
+
+                        for (int i = 0; i < WARMUP_FRAMES; i++) detector.step();
+                        metrics.reset();
+
+                        double radius = 0;
+                        auto begin = std::chrono::steady_clock::now();
+                        for (int i = 0; i < frames; i++)
+                        {
+                            detector.step();
+                            ScopedTimer timer(radius_ns);
+                            radius += detector.getTurningRadius();
+                        }
+                        auto end = std::chrono::steady_clock::now();
+                        double fps = frames / std::chrono::duration<double>(end - begin).count();
+                        double reads_per_frame = reads.summarize().mean;
+
+                        // Unknown for recorded video
+                        const Lane &lane = detector.getLane();
+                        double left_err = -1, right_err = -1;
+                        if (source.empty())
+                        {
+                            left_err = lane_error(lane.getLParams(), lane.getDegree(),
+                                    generator.getLeft(), generator.getDegree(), size.height);
+                            right_err = lane_error(lane.getRParams(), lane.getDegree(),
+                                    generator.getRight(), generator.getDegree(), size.height);
+                        }
+
+                        // Distance from the single-level lane, which always runs first
+                        double vs_single = 0;
+                        if (pyramid == 0)
+                        {
+                            std::copy(lane.getLParams(), lane.getLParams() + lane.getDegree(), single_left);
+                            std::copy(lane.getRParams(), lane.getRParams() + lane.getDegree(), single_right);
+                        }
+                        else
+                        {
+                            vs_single = (lane_error(lane.getLParams(), lane.getDegree(), single_left, degree, size.height) +
+                                         lane_error(lane.getRParams(), lane.getDegree(), single_right, degree, size.height)) / 2;
+                        }
+
+                        if (json)
+                        {
+                            cout << "{\"mode\":\"" << mode << "\",\"width\":" << size.width << ",\"height\":" << size.height
+                                 << ",\"row_step\":" << step.row << ",\"col_step\":" << step.col
+                                 << ",\"threshold\":" << threshold << ",\"n\":" << degree << ",\"pyramid\":" << pyramid
+                                 << ",\"frames\":" << frames << ",\"fps\":" << fps
+                                 << ",\"left_err_px\":" << left_err << ",\"right_err_px\":" << right_err
+                                 << ",\"vs_single_px\":" << vs_single
+                                 << ",\"reads\":" << reads_per_frame << ",\"stages\":{";
+                            for (size_t i = 0; i < sizeof(stages) / sizeof(stages[0]); i++)
+                            {
+                                Histogram::Summary s = stages[i].histogram.summarize();
+                                cout << (i ? "," : "") << "\"" << stages[i].name << "\":{"
+                                     << "\"count\":" << s.count << ",\"mean_us\":" << s.mean / 1000
+                                     << ",\"p50_us\":" << s.p50 / 1000.0 << ",\"p95_us\":" << s.p95 / 1000.0
+                                     << ",\"p99_us\":" << s.p99 / 1000.0 << ",\"max_us\":" << s.max / 1000.0 << "}";
+                            }
+                            cout << "}}" << endl;
+                        }
+                        else
+                        {
+                            cout << mode << "," << size.width << "," << size.height << ","
+                                 << step.row << "," << step.col << "," << threshold << "," << degree << "," << pyramid << ","
+                                 << frames << "," << fps << "," << left_err << "," << right_err << ","
+                                 << vs_single << "," << reads_per_frame;
+                            for (const Stage &stage : stages)
+                            {
+                                Histogram::Summary s = stage.histogram.summarize();
+                                cout << "," << s.mean / 1000 << "," << s.p50 / 1000.0 << "," << s.p95 / 1000.0
+                                     << "," << s.p99 / 1000.0 << "," << s.max / 1000.0;
+                            }
+                            cout << endl;
+                        }
+
+                        // Keeps the radius computation from being optimized away
+                        volatile double sink = radius;
+                        (void)sink;
+                    }
+                }
+            }
+        }
+    }
+
+    unlink(tmp_path);
+}
@@ -0,0 +1,157 @@
+/**
+ * bench_fit.cpp
+ * Times FixedFitter against polynomialfit() on lane-like hits and checks that
+ * both produce the same curve. Exits with 1 if they disagree.
+ * Also times RecursiveFitter (lane.estimator = "rls") taking the same hits
+ * frame after frame; rls_diff_px is how far it is from polynomialfit() on a
+ * single frame without forgetting, where only its prior sets them apart.
+ *
+ * Usage: bench_fit [height] [row_step] [iterations]
+ */
+
+using namespace std;
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "fixedfit.h"
+#include "rlsfit.h"
+#include "polifitgsl.h"
+
+#define TOLERANCE 1e-6 // maximum allowed difference between the curves, in pixels
+
+struct Hits
+{
+    std::vector<int> slots;
+    std::vector<double> ys;
+    std::vector<double> xs;
+};
+
+/**
+ * Samples a curved lane on the detector's row grid, leaving out some rows
+ */
+Hits make_hits(int degree, int height, int row_step, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> coeff(-1.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 1.5);
+    std::bernoulli_distribution missing(0.3);
+
+    std::vector<double> c(degree);
+    c[0] = height / 3.0;
+    for (int k = 1; k < degree; k++) c[k] = coeff(rng) * pow(height, 1 - k);
+
+    Hits hits;
+    for (int i = height - 1, slot = 1; i >= 0; i -= row_step, slot++)
+    {
+        if (missing(rng)) continue;
+        double x = 0;
+        for (int k = degree - 1; k >= 0; k--) x = x * i + c[k];
+        hits.slots.push_back(slot);
+        hits.ys.push_back(i);
+        hits.xs.push_back(x + noise(rng));
+    }
+    return hits;
+}
+
+double evaluate(const double *c, int degree, double y)
+{
+    double x = 0;
+    for (int k = degree - 1; k >= 0; k--) x = x * y + c[k];
+    return x;
+}
+
+template <int N>
+bool run(int height, int row_step, int iterations)
+{
+    std::mt19937 rng(N);
+    FixedFitter<N> fitter(height, row_step);
+    std::vector<Hits> sets;
+    for (int s = 0; s < 64; s++) sets.push_back(make_hits(N, height, row_step, rng));
+
+    // Equivalence
+    double max_diff = 0;
+    double rls_diff = 0;
+    for (const Hits &hits : sets)
+    {
+        double gsl[N], fixed[N], rls[N];
+        polynomialfit(hits.ys.size(), N, &hits.ys[0], &hits.xs[0], gsl);
+        fitter.reset();
+        for (size_t i = 0; i < hits.slots.size(); i++) fitter.add(hits.slots[i], hits.xs[i]);
+        fitter.solve(fixed);
+        RecursiveFitter<N> single(height, row_step, 1.0);
+        for (size_t i = 0; i < hits.slots.size(); i++) single.add(hits.slots[i], hits.xs[i]);
+        single.solve(rls);
+        for (int y = 0; y <= height; y++)
+        {
+            max_diff = std::max(max_diff, std::fabs(evaluate(gsl, N, y) - evaluate(fixed, N, y)));
+            rls_diff = std::max(rls_diff, std::fabs(evaluate(gsl, N, y) - evaluate(rls, N, y)));
+        }
+    }
+
+    // Timing
+    double sink = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++)
+    {
+        const Hits &hits = sets[it % sets.size()];
+        double c[N];
+        polynomialfit(hits.ys.size(), N, &hits.ys[0], &hits.xs[0], c);
+        sink += c[0];
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++)
+    {
+        const Hits &hits = sets[it % sets.size()];
+        double c[N];
+        fitter.reset();
+        for (size_t i = 0; i < hits.slots.size(); i++) fitter.add(hits.slots[i], hits.xs[i]);
+        fitter.solve(c);
+        sink += c[0];
+    }
+    auto end = std::chrono::steady_clock::now();
+    RecursiveFitter<N> recursive(height, row_step, 0.9);
+    for (int it = 0; it < iterations; it++)
+    {
+        const Hits &hits = sets[it % sets.size()];
+        double c[N];
+        for (size_t i = 0; i < hits.slots.size(); i++) recursive.add(hits.slots[i], hits.xs[i]);
+        recursive.solve(c);
+        recursive.reset();
+        sink += c[0];
+    }
+    auto rls_end = std::chrono::steady_clock::now();
+
+    double gsl_ns = std::chrono::duration<double, std::nano>(middle - begin).count() / iterations;
+    double fixed_ns = std::chrono::duration<double, std::nano>(end - middle).count() / iterations;
+    double rls_ns = std::chrono::duration<double, std::nano>(rls_end - end).count() / iterations;
+
+    cout << N << "," << sets[0].slots.size() << ","
+         << gsl_ns << "," << fixed_ns << "," << gsl_ns / fixed_ns << ","
+         << max_diff << (sink != sink ? " nan" : "") << ","
+         << rls_ns << "," << rls_diff << endl;
+    return max_diff <= TOLERANCE;
+}
+
+int main(int argc, char* argv[])
+{
+    int height = argc > 1 ? atoi(argv[1]) : 480;
+    int row_step = argc > 2 ? atoi(argv[2]) : 10;
+    int iterations = argc > 3 ? atoi(argv[3]) : 20000;
+
+    cout << "n,hits,gsl_ns,fixed_ns,speedup,max_diff_px,rls_ns,rls_diff_px" << endl;
+    bool ok = run<2>(height, row_step, iterations);
+    ok = run<3>(height, row_step, iterations) && ok;
+    ok = run<4>(height, row_step, iterations) && ok;
+    ok = run<5>(height, row_step, iterations) && ok;
+
+    if (!ok)
+    {
+        cerr << "FixedFitter differs from polynomialfit by more than " << TOLERANCE << " px" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * bench_ldmap.cpp
+ * Measures LDMap decoding throughput in frames/s: the byte-at-a-time state
+ * machine the serial reader used before, LDMapParser, and LDMapParser handing
+ * frames to a consumer thread through SpscQueue. The stream contains garbage
+ * and corrupt frames and is delivered in reads of a fixed size. Exits with 1
+ * if the parsers disagree.
+ *
+ * Usage: bench_ldmap [frames] [repetitions]
+ */
+
+using namespace std;
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "ldmap.h"
+#include "spsc.h"
+
+/**
+ * The per-byte state machine formerly in SerialCommunication::receiveData
+ */
+class BytewiseParser
+{
+    enum {WaitForFirstStart, WaitForSecondStart, WaitForLength, WaitForData, WaitForCheckSum};
+
+    uint8_t state = WaitForFirstStart;
+    uint8_t buffer[sizeof(LDMap)];
+    uint8_t ch = 0;
+    uint8_t length = 0;
+    uint8_t iByte = 0;
+
+public:
+    void parse(const uint8_t *data, size_t size, std::vector<LDMap> &frames)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            uint8_t c = data[i];
+            switch (state)
+            {
+                case WaitForFirstStart:
+                    if (c == UART_FIRST_BYTE) state = WaitForSecondStart;
+                    break;
+                case WaitForSecondStart:
+                    state = c == UART_SECOND_BYTE ? WaitForLength : WaitForFirstStart;
+                    break;
+                case WaitForLength:
+                    if (c == sizeof(LDMap))
+                    {
+                        ch = 0;
+                        length = c;
+                        iByte = 0;
+                        state = WaitForData;
+                    }
+                    else state = WaitForFirstStart;
+                    break;
+                case WaitForData:
+                    ch += c;
+                    buffer[iByte++] = c;
+                    if (iByte == length) state = WaitForCheckSum;
+                    break;
+                case WaitForCheckSum:
+                    if (ch == c)
+                    {
+                        frames.emplace_back();
+                        memcpy(&frames.back(), buffer, sizeof(LDMap));
+                    }
+                    state = WaitForFirstStart;
+                    break;
+            }
+        }
+    }
+};
+
+/**
+ * Builds a stream of frames, with random bytes (never a start byte) between
+ * some of them and a corrupted checksum on a few
+ */
+std::vector<uint8_t> make_stream(int frames, int &valid)
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<int> gap(0, 8);
+    std::bernoulli_distribution noisy(0.1);
+    std::bernoulli_distribution corrupt(0.01);
+
+    std::vector<uint8_t> stream;
+    uint8_t frame[LDMapParser::FRAME_SIZE];
+    valid = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        if (noisy(rng))
+        {
+            for (int k = gap(rng); k > 0; k--)
+            {
+                uint8_t b = byte(rng);
+                stream.push_back(b == UART_FIRST_BYTE ? 0 : b);
+            }
+        }
+        LDMap ldmap;
+        memset(&ldmap, 0, sizeof(LDMap));
+        ldmap.id = i;
+        ldmap.timestamp = i;
+        ldmap.distance = byte(rng);
+        LDMapParser::frame(ldmap, frame);
+        if (corrupt(rng)) frame[LDMapParser::FRAME_SIZE - 1]++;
+        else valid++;
+        stream.insert(stream.end(), frame, frame + LDMapParser::FRAME_SIZE);
+    }
+    return stream;
+}
+
+template <typename Parser>
+double run(Parser &parser, const std::vector<uint8_t> &stream, size_t read_size, int repetitions, std::vector<LDMap> &frames)
+{
+    std::vector<LDMap> out;
+    out.reserve(read_size);
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++)
+    {
+        frames.clear();
+        for (size_t pos = 0; pos < stream.size(); pos += read_size)
+        {
+            out.clear();
+            parser.parse(stream.data() + pos, std::min(read_size, stream.size() - pos), out);
+            frames.insert(frames.end(), out.begin(), out.end());
+        }
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+/**
+ * LDMapParser on this thread, callbacks replaced by a consumer thread popping
+ * from the queue
+ */
+double run_handoff(const std::vector<uint8_t> &stream, size_t read_size, int repetitions, uint64_t &consumed)
+{
+    SpscQueue<LDMap> queue(256);
+    std::atomic<bool> done(false);
+    std::atomic<uint64_t> count(0);
+    std::thread consumer([&]() {
+        LDMap ldmap;
+        uint64_t n = 0;
+        while (true)
+        {
+            if (queue.pop(ldmap)) n++;
+            else if (done) break;
+            else std::this_thread::yield();
+        }
+        while (queue.pop(ldmap)) n++;
+        count = n;
+    });
+
+    LDMapParser parser;
+    std::vector<LDMap> out;
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; r++)
+    {
+        for (size_t pos = 0; pos < stream.size(); pos += read_size)
+        {
+            out.clear();
+            parser.parse(stream.data() + pos, std::min(read_size, stream.size() - pos), out);
+            for (const LDMap &ldmap : out)
+            {
+                while (!queue.push(ldmap)) std::this_thread::yield();
+            }
+        }
+    }
+    done = true;
+    consumer.join();
+    consumed = count;
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+int main(int argc, char* argv[])
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 100000;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 10;
+
+    int valid;
+    std::vector<uint8_t> stream = make_stream(frames, valid);
+    double mb = (double)stream.size() * repetitions / 1e6;
+
+    int status = 0;
+    cout << "parser,read_size,frames,frames_per_s,mb_per_s" << endl;
+    for (size_t read_size : {1, 16, 64, 4096})
+    {
+        BytewiseParser bytewise;
+        LDMapParser bulk;
+        std::vector<LDMap> expected, actual;
+        double bytewise_s = run(bytewise, stream, read_size, repetitions, expected);
+        double bulk_s = run(bulk, stream, read_size, repetitions, actual);
+        uint64_t consumed;
+        double handoff_s = run_handoff(stream, read_size, repetitions, consumed);
+
+        if ((int)expected.size() != valid || actual.size() != expected.size() ||
+            memcmp(actual.data(), expected.data(), actual.size() * sizeof(LDMap)) != 0 ||
+            consumed != (uint64_t)valid * repetitions)
+        {
+            cerr << "Parsers disagree at read size " << read_size << ": expected " << valid
+                 << ", bytewise " << expected.size() << ", bulk " << actual.size()
+                 << ", handoff " << consumed / repetitions << endl;
+            status = 1;
+        }
+
+        double n = (double)valid * repetitions;
+        cout << "bytewise," << read_size << "," << valid << "," << n / bytewise_s << "," << mb / bytewise_s << endl;
+        cout << "bulk," << read_size << "," << valid << "," << n / bulk_s << "," << mb / bulk_s << endl;
+        cout << "bulk+spsc," << read_size << "," << valid << "," << n / handoff_s << "," << mb / handoff_s << endl;
+    }
+    return status;
+}
@@ -0,0 +1,145 @@
+/**
+ * bench_poly.cpp
+ * Times evaluating both lane lines over every row of a frame three ways:
+ * the original evaluator (coefficients copied out of the Lane in a vector,
+ * one pow() per term), the inline Horner polynomial() on coefficient arrays,
+ * and lanePositions(), which evaluates several rows at once. Exits with 1 if
+ * lanePositions() disagrees with polynomial().
+ *
+ * Usage: bench_poly [rows] [iterations]
+ *
+ * simd names the instruction set lanePositions() was compiled for; build
+ * with -DNATIVE=ON to use AVX where the machine has it.
+ */
+
+using namespace std;
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "lane.h"
+#include "polynomial.h"
+
+#define TOLERANCE 1e-9 // maximum allowed difference between the evaluators, in pixels
+
+#if defined(__AVX__)
+#define SIMD "avx"
+#elif defined(__SSE2__)
+#define SIMD "sse2"
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SIMD "neon"
+#else
+#define SIMD "none"
+#endif
+
+/**
+ * Coefficients kept the way Lane kept them before they moved inline
+ */
+struct VectorLane
+{
+    std::vector<double> lparams;
+    std::vector<double> rparams;
+
+    std::vector<double> getLParams() const { return lparams; }
+    std::vector<double> getRParams() const { return rparams; }
+};
+
+/**
+ * The original evaluator, taking the coefficients by value
+ */
+__attribute__((noinline)) double power_sum(std::vector<double> params, double x)
+{
+    double val = 0;
+    for (unsigned i = 0; i < params.size(); i++)
+    {
+        val += params[i] * pow(x, i);
+    }
+    return val;
+}
+
+template <typename F>
+double time_ns(int iterations, F f)
+{
+    auto begin = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++) f(it);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / iterations;
+}
+
+bool run(int degree, int rows, int iterations)
+{
+    std::mt19937 rng(degree);
+    std::uniform_real_distribution<double> coeff(-1.0, 1.0);
+    VectorLane vector_lane;
+    double lparams[LANE_MAX_DEGREE], rparams[LANE_MAX_DEGREE];
+    for (int k = 0; k < degree; k++)
+    {
+        lparams[k] = coeff(rng) * pow(rows, 1 - k) + (k == 0 ? rows / 3.0 : 0);
+        rparams[k] = coeff(rng) * pow(rows, 1 - k) + (k == 0 ? 2 * rows / 3.0 : 0);
+    }
+    vector_lane.lparams.assign(lparams, lparams + degree);
+    vector_lane.rparams.assign(rparams, rparams + degree);
+
+    std::vector<double> ys(rows), left(rows), right(rows), check_left(rows), check_right(rows);
+    for (int y = 0; y < rows; y++) ys[y] = rows - 1 - y;
+
+    // Equivalence
+    lanePositions(lparams, rparams, degree, &ys[0], rows, &left[0], &right[0]);
+    double max_diff = 0;
+    for (int y = 0; y < rows; y++)
+    {
+        max_diff = std::max(max_diff, std::fabs(left[y] - polynomial(lparams, degree, ys[y])));
+        max_diff = std::max(max_diff, std::fabs(right[y] - polynomial(rparams, degree, ys[y])));
+    }
+
+    // Timing
+    double sink = 0;
+    double vector_ns = time_ns(iterations, [&](int it) {
+        for (int y = 0; y < rows; y++)
+        {
+            check_left[y] = power_sum(vector_lane.getLParams(), ys[y]);
+            check_right[y] = power_sum(vector_lane.getRParams(), ys[y]);
+        }
+        sink += check_left[it % rows];
+    });
+    double horner_ns = time_ns(iterations, [&](int it) {
+        for (int y = 0; y < rows; y++)
+        {
+            check_left[y] = polynomial(lparams, degree, ys[y]);
+            check_right[y] = polynomial(rparams, degree, ys[y]);
+        }
+        sink += check_left[it % rows];
+    });
+    double batched_ns = time_ns(iterations, [&](int it) {
+        lanePositions(lparams, rparams, degree, &ys[0], rows, &left[0], &right[0]);
+        sink += left[it % rows];
+    });
+
+    cout << degree << "," << rows << "," << SIMD << ","
+         << vector_ns / 1000 << "," << horner_ns / 1000 << "," << batched_ns / 1000 << ","
+         << vector_ns / batched_ns << "," << max_diff << (sink != sink ? " nan" : "") << endl;
+    return max_diff <= TOLERANCE;
+}
+
+int main(int argc, char* argv[])
+{
+    int rows = argc > 1 ? atoi(argv[1]) : 480;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20000;
+
+    cout << "degree,rows,simd,vector_pow_us,horner_us,batched_us,speedup,max_diff_px" << endl;
+    bool ok = true;
+    for (int degree = 2; degree <= LANE_MAX_DEGREE; degree++)
+    {
+        ok = run(degree, rows, iterations) && ok;
+    }
+
+    if (!ok)
+    {
+        cerr << "lanePositions differs from polynomial by more than " << TOLERANCE << " px" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * bench_preprocess.cpp
+ * Compares thresh() + warpPerspective() against the Preprocessor lookup table
+ * on RoadGenerator frames at 480p, 720p and 1080p.
+ *
+ * Usage: bench_preprocess [config file] [iterations]
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <libconfig.h++>
+
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+#include "preprocess.h"
+#include "roadgen.h"
+
+using namespace cv;
+
+template <typename F>
+double time_ms(int iterations, F f)
+{
+    f();
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count() / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    double angle = 0.239;
+    double floor = 0.847;
+    double ceiling = 0.188;
+    int threshold = 180;
+    int iterations = argc > 2 ? atoi(argv[2]) : 50;
+
+    if (argc > 1)
+    {
+        try
+        {
+            libconfig::Config cfg;
+            cfg.readFile(argv[1]);
+            angle = cfg.lookup("camera.angle");
+            floor = cfg.lookup("camera.frame.floor");
+            ceiling = cfg.lookup("camera.frame.ceiling");
+            threshold = cfg.lookup("camera.threshold");
+        }
+        catch(const std::exception &exc)
+        {
+            cerr << "Invalid config file" << endl;
+            cerr << exc.what() << endl;
+            return 1;
+        }
+    }
+
+    const Size sizes[] = {Size(640, 480), Size(1280, 720), Size(1920, 1080)};
+
+    cout << "resolution,warp_ms,remap_ms,speedup,agreement" << endl;
+    for (const Size &size : sizes)
+    {
+        RoadGenerator::Params params;
+        params.width = size.width;
+        params.height = size.height;
+        Mat frame = RoadGenerator(params, angle, floor, ceiling).render();
+        Mat m = Detector::getTransformMatrix(size.height, size.width, angle, floor, ceiling);
+        Preprocessor preprocessor(m, size.width, size.height, threshold);
+
+        Mat th, warped, remapped;
+        double warp_ms = time_ms(iterations, [&]() {
+            thresh(frame, th, threshold);
+            warpPerspective(th, warped, m, size);
+        });
+        double remap_ms = time_ms(iterations, [&]() {
+            preprocessor.apply(frame, remapped);
+        });
+
+        // Detector only accepts exact 255 hits, so compare on that
+        int same = 0;
+        for (int i = 0; i < size.height; i++)
+        {
+            for (int j = 0; j < size.width; j++)
+            {
+                same += (warped.at<uchar>(i, j) == 255) == (remapped.at<uchar>(i, j) == 255);
+            }
+        }
+
+        cout << size.width << "x" << size.height << ","
+             << warp_ms << "," << remap_ms << ","
+             << warp_ms / remap_ms << ","
+             << (double)same / size.area() << endl;
+    }
+}
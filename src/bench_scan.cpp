@@ -0,0 +1,161 @@
+/**
+ * bench_scan.cpp
+ * Compares the byte-wise lane pixel search of Detector (probing left +- j
+ * and right +- j one pixel at a time) against BitMask::nearest() on the
+ * bit-packed mask, on RoadGenerator birdseye masks.
+ *
+ * Every detector.row_step-th row is searched for both lines around a
+ * prediction that is off by a few pixels, as after a frame of motion. Times
+ * are per frame; pack_us is the extra cost of packing those rows of the mask,
+ * paid once per frame in bitmask mode.
+ * agreement is the share of searches where both find the same column; it is
+ * 1 with col_step 1, where both return the nearest lane pixel.
+ *
+ * Usage: bench_scan [config file] [iterations]
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <libconfig.h++>
+
+#include "opencv2/opencv.hpp"
+
+#include "bitmask.h"
+#include "detector.h"
+#include "polynomial.h"
+#include "preprocess.h"
+#include "roadgen.h"
+
+using namespace cv;
+
+#define MAX_OFFSET 6 // pixels between the predicted and the true lane line
+
+template <typename F>
+double time_us(int iterations, F f)
+{
+    f();
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - begin).count() / iterations;
+}
+
+/**
+ * The search of Detector::search() with a byte mask, for one row and line
+ */
+int probe_bytes(const Mat &mask, int i, int center, int inner, int threshold, int col_step)
+{
+    auto probe = [&mask](int i, int j) { return j >= 0 && j < mask.cols && mask.at<uchar>(i, j) == 255; };
+    for (int j = 0; j <= threshold; j+=col_step)
+    {
+        if (probe(i, center + inner * j)) return center + inner * j;
+        if (j == 0) continue;
+        if (probe(i, center - inner * j)) return center - inner * j;
+    }
+    return -1;
+}
+
+int main(int argc, char* argv[])
+{
+    double angle = 0.239;
+    double floor = 0.847;
+    double ceiling = 0.188;
+    int threshold = 180;
+    int row_step = 10;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+
+    if (argc > 1)
+    {
+        try
+        {
+            libconfig::Config cfg;
+            cfg.readFile(argv[1]);
+            angle = cfg.lookup("camera.angle");
+            floor = cfg.lookup("camera.frame.floor");
+            ceiling = cfg.lookup("camera.frame.ceiling");
+            threshold = cfg.lookup("camera.threshold");
+            row_step = cfg.lookup("detector.row_step");
+        }
+        catch(const std::exception &exc)
+        {
+            cerr << "Invalid config file" << endl;
+            cerr << exc.what() << endl;
+            return 1;
+        }
+    }
+
+    const Size sizes[] = {Size(640, 480), Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const int windows[] = {15, 60};
+    const int col_steps[] = {1, 2};
+
+    cout << "resolution,window,col_step,byte_us,bitmask_us,pack_us,speedup,speedup_with_pack,agreement" << endl;
+    for (const Size &size : sizes)
+    {
+        RoadGenerator::Params params;
+        params.width = size.width;
+        params.height = size.height;
+        params.occlusion = 0.3;
+        RoadGenerator generator(params, angle, floor, ceiling);
+        Mat frame = generator.render();
+        Mat m = Detector::getTransformMatrix(size.height, size.width, angle, floor, ceiling);
+
+        Mat th, mask;
+        thresh(frame, th, threshold);
+        warpPerspective(th, mask, m, size);
+
+        BitMask bits;
+        double pack_us = time_us(iterations, [&]() { bits.pack(mask, row_step); });
+
+        // Predictions: the true lines shifted by a random offset per row
+        std::mt19937 rng(1);
+        std::uniform_int_distribution<int> offset(-MAX_OFFSET, MAX_OFFSET);
+        std::vector<int> left(size.height), right(size.height);
+        for (int i = 0; i < size.height; i++)
+        {
+            left[i] = (int)polynomial(generator.getLeft(), generator.getDegree(), i) + offset(rng);
+            right[i] = (int)polynomial(generator.getRight(), generator.getDegree(), i) + offset(rng);
+        }
+
+        for (int window : windows)
+        {
+            for (int col_step : col_steps)
+            {
+                long sink = 0;
+                double byte_us = time_us(iterations, [&]() {
+                    for (int i = size.height - 1; i >= 0; i -= row_step)
+                    {
+                        sink += probe_bytes(mask, i, left[i], 1, window, col_step);
+                        sink += probe_bytes(mask, i, right[i], -1, window, col_step);
+                    }
+                });
+                double bits_us = time_us(iterations, [&]() {
+                    for (int i = size.height - 1; i >= 0; i -= row_step)
+                    {
+                        sink += bits.nearest(i, left[i], window, 1);
+                        sink += bits.nearest(i, right[i], window, -1);
+                    }
+                });
+
+                int same = 0, searches = 0;
+                for (int i = size.height - 1; i >= 0; i -= row_step, searches += 2)
+                {
+                    same += probe_bytes(mask, i, left[i], 1, window, col_step) == bits.nearest(i, left[i], window, 1);
+                    same += probe_bytes(mask, i, right[i], -1, window, col_step) == bits.nearest(i, right[i], window, -1);
+                }
+
+                cout << size.width << "x" << size.height << "," << window << "," << col_step << ","
+                     << byte_us << "," << bits_us << "," << pack_us << ","
+                     << byte_us / bits_us << "," << byte_us / (bits_us + pack_us) << ","
+                     << (double)same / searches << endl;
+
+                // Keeps the searches from being optimized away
+                volatile long keep = sink;
+                (void)keep;
+            }
+        }
+    }
+}
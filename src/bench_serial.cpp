@@ -0,0 +1,178 @@
+/**
+ * bench_serial.cpp
+ * Exercises SerialCommunication against McuEmulator on a pseudo-terminal:
+ *   latency:    commands at a steady rate, time from sendCommand() to arrival at the MCU
+ *   ldmap:      LDMap frames at increasing rates with 1% corrupt frames and
+ *               garbage, received frames/s, checksum errors and queue drops
+ *   slow_ldmap: same, with a callback that takes 1 ms, to show queue overflow
+ *   saturate:   sendCommand() in a tight loop, how the mailbox coalesces
+ *
+ * A PTY has no baud rate, so the numbers show software overhead only.
+ *
+ * Usage: bench_serial [seconds per run]
+ */
+
+using namespace std;
+
+#include <iostream>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include "uartcommander.h"
+#include "mcuemulator.h"
+#include "metrics.h"
+
+#define COMMAND_HZ 100
+#define SEQUENCES 32768 // distinct sequence numbers carried in UARTCommand.distance
+
+typedef McuEmulator::Clock Clock;
+
+void print_row(const string &test, double rate, double seconds, uint64_t sent, uint64_t received,
+        uint64_t dropped, uint64_t errors, const Histogram::Summary *latency)
+{
+    cout << test << "," << rate << "," << seconds << "," << sent << "," << received << ","
+         << received / seconds << "," << dropped << "," << errors << ",";
+    if (latency != nullptr)
+    {
+        cout << latency->p50 / 1000.0 << "," << latency->p99 / 1000.0 << "," << latency->max / 1000.0;
+    }
+    else
+    {
+        cout << ",,";
+    }
+    cout << endl;
+}
+
+UARTCommand make_command(int sequence)
+{
+    UARTCommand command;
+    command.maxTime = 500;
+    command.speed = 0;
+    command.orientation = 0;
+    command.distance = sequence;
+    command.dir = 0;
+    return command;
+}
+
+/**
+ * Steady command stream while the MCU sends LDMaps at 50 Hz
+ */
+void run_latency(double seconds)
+{
+    Metrics::instance().reset();
+    Histogram latency;
+    std::vector<Clock::time_point> sent_at(SEQUENCES);
+
+    McuEmulator::Params params;
+    McuEmulator mcu(params);
+    mcu.onCommand([&](const UARTCommand &command, Clock::time_point arrival) {
+        latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(arrival - sent_at[command.distance]).count());
+    });
+    mcu.start();
+
+    SerialCommunication serial(mcu.getPortName(), 115200);
+    serial.run();
+
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / COMMAND_HZ));
+    Clock::time_point next = Clock::now();
+    Clock::time_point end = next + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    int sequence = 0;
+    while (next < end)
+    {
+        std::this_thread::sleep_until(next);
+        next += period;
+        sent_at[sequence] = Clock::now();
+        serial.sendCommand(make_command(sequence));
+        sequence = (sequence + 1) % SEQUENCES;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    mcu.stop();
+
+    McuEmulator::Stats stats = mcu.getStats();
+    CommandMailbox::Stats commands = serial.getCommandStats();
+    Histogram::Summary summary = latency.summarize();
+    print_row("latency", COMMAND_HZ, seconds, commands.posted, stats.commands_received,
+            commands.coalesced + commands.expired, stats.command_errors, &summary);
+}
+
+/**
+ * LDMap stream at a given rate into one callback
+ * @param callback_us time each callback takes
+ */
+void run_ldmap(const string &test, double rate, double seconds, int callback_us)
+{
+    Metrics::instance().reset();
+    std::atomic<uint64_t> received(0);
+
+    McuEmulator::Params params;
+    params.ldmap_hz = rate;
+    params.corruption = 0.01;
+    params.garbage = 0.05;
+    McuEmulator mcu(params);
+
+    SerialCommunication serial(mcu.getPortName(), 115200);
+    serial.register_callback([&received, callback_us](const LDMap &) {
+        if (callback_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(callback_us));
+        received++;
+    });
+    serial.run();
+    mcu.start();
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    mcu.stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    McuEmulator::Stats stats = mcu.getStats();
+    uint64_t dropped = Metrics::instance().counter("serial.ldmap_dropped").get();
+    uint64_t errors = Metrics::instance().counter("serial.ldmap_checksum_errors").get();
+    print_row(test, rate, seconds, stats.ldmaps_sent, received, dropped, errors, nullptr);
+}
+
+/**
+ * Commands posted as fast as possible
+ */
+void run_saturate(double seconds)
+{
+    Metrics::instance().reset();
+    McuEmulator::Params params;
+    McuEmulator mcu(params);
+    mcu.start();
+
+    SerialCommunication serial(mcu.getPortName(), 115200);
+    serial.run();
+
+    Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    int sequence = 0;
+    while (Clock::now() < end)
+    {
+        serial.sendCommand(make_command(sequence));
+        sequence = (sequence + 1) % SEQUENCES;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    mcu.stop();
+
+    CommandMailbox::Stats stats = serial.getCommandStats();
+    Histogram::Summary wire = Metrics::instance().histogram("serial.enqueue_to_wire_ns").summarize();
+    print_row("saturate", 0, seconds, stats.posted, mcu.getStats().commands_received,
+            stats.coalesced, stats.expired, &wire);
+}
+
+int main(int argc, char* argv[])
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    Metrics::instance().enable(true);
+
+    // dropped: coalesced or expired commands (latency), queue overflows (ldmap), coalesced commands (saturate)
+    // errors: corrupt command frames (latency), LDMap checksum errors (ldmap), expired commands (saturate)
+    cout << "test,rate_hz,seconds,sent,received,received_per_s,dropped,errors,p50_us,p99_us,max_us" << endl;
+    run_latency(seconds);
+    for (double rate : {100.0, 1000.0, 10000.0, 50000.0})
+    {
+        run_ldmap("ldmap", rate, seconds, 0);
+    }
+    run_ldmap("slow_ldmap", 2000.0, seconds, 1000);
+    run_saturate(seconds);
+}
@@ -0,0 +1,72 @@
+/**
+ * bench_streams.cpp
+ * Measures how StreamEngine throughput scales from 1 to 8 independent
+ * detection streams on a fixed worker pool.
+ *
+ * Usage: bench_streams <config file> [seconds per run] [workers]
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+#include "streams.h"
+#include "roadgen.h"
+
+using namespace cv;
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <config file> [seconds per run] [workers]" << endl;
+        return 0;
+    }
+    string config_path(argv[1]);
+    double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    int workers = argc > 3 ? atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    // Streams only read the frame, so they can all share it
+    Mat frame = RoadGenerator(config_path, RoadGenerator::Params()).render();
+
+    cout << "streams,workers,total_fps,min_stream_fps,max_stream_fps,fairness,max_wait_ms" << endl;
+    for (int n = 1; n <= 8; n++)
+    {
+        std::vector<std::unique_ptr<Detector>> detectors;
+        StreamEngine engine(workers);
+        for (int i = 0; i < n; i++)
+        {
+            detectors.emplace_back(new Detector(config_path, [frame]() { return frame; }));
+            engine.addStream(detectors.back().get(), nullptr);
+        }
+
+        engine.start();
+        std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+        engine.stop();
+
+        double sum = 0, sum_sq = 0, min_fps = 1e300, max_fps = 0, max_wait = 0;
+        for (int i = 0; i < n; i++)
+        {
+            StreamEngine::Stats stats = engine.getStats(i);
+            sum += stats.fps;
+            sum_sq += stats.fps * stats.fps;
+            min_fps = std::min(min_fps, stats.fps);
+            max_fps = std::max(max_fps, stats.fps);
+            max_wait = std::max(max_wait, stats.max_wait_ms);
+        }
+
+        // Jain's fairness index: 1 when every stream got the same frame rate
+        double fairness = sum_sq > 0 ? sum * sum / (n * sum_sq) : 0;
+
+        cout << n << "," << workers << "," << engine.getThroughput() << ","
+             << min_fps << "," << max_fps << "," << fairness << "," << max_wait << endl;
+    }
+}
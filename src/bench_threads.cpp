@@ -0,0 +1,184 @@
+/**
+ * bench_threads.cpp
+ * Measures single-frame latency of Detector::step() with detector.threads
+ * set to 1, 2 and 4. Each run is pinned to that many cores, so the numbers
+ * show what the striped preprocessing and the concurrent left/right search
+ * gain on a 1, 2 or 4 core machine. OpenCV's own threading is turned off for
+ * every run, the single-threaded one included.
+ *
+ * Usage: bench_threads <config file> [frames] [name=value ...]
+ *   frames:     frames timed per run (default 200)
+ *   name=value: RoadGenerator settings, e.g. curvature=0.1
+ *
+ * lane_diff_px is the largest distance between the lane of a run and the
+ * lane of the single-threaded run, over all rows; it should be 0.
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <sched.h>
+#include <unistd.h>
+#include <libconfig.h++>
+
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+#include "metrics.h"
+#include "polynomial.h"
+#include "roadgen.h"
+
+using namespace cv;
+
+#define WARMUP_FRAMES 10
+#define SYNTHETIC_FRAMES 16
+
+/**
+ * Restricts the process to the first `cores` CPUs it may run on
+ * @return number of CPUs actually allowed
+ */
+int pin(const cpu_set_t &allowed, int cores)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int n = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < cores; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            CPU_SET(cpu, &set);
+            n++;
+        }
+    }
+    sched_setaffinity(0, sizeof(set), &set);
+    return n;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <config file> [frames] [name=value ...]" << endl;
+        return 0;
+    }
+    string config_path(argv[1]);
+    int frames = argc > 2 ? atoi(argv[2]) : 200;
+
+    RoadGenerator::Params road;
+    for (int i = 3; i < argc; i++)
+    {
+        if (!RoadGenerator::parse(road, argv[i]))
+        {
+            cerr << "Unknown setting " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    libconfig::Config cfg;
+    char tmp_path[] = "/tmp/bench_threads_XXXXXX";
+    try
+    {
+        cfg.readFile(config_path.c_str());
+    }
+    catch(...)
+    {
+        cerr << "Invalid config file" << endl;
+        return 1;
+    }
+    int fd = mkstemp(tmp_path);
+    if (fd < 0)
+    {
+        cerr << "Could not create temporary config file" << endl;
+        return 1;
+    }
+    close(fd);
+
+    cv::setNumThreads(1);
+    cpu_set_t allowed;
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    Metrics &metrics = Metrics::instance();
+    metrics.enable(true);
+    Histogram &update_ns = metrics.histogram("detector.update_ns");
+    Histogram &preprocess_ns = metrics.histogram("detector.preprocess_ns");
+    Histogram &search_ns = metrics.histogram("detector.search_ns");
+
+    const Size sizes[] = {Size(1280, 720), Size(1920, 1080), Size(3840, 2160)};
+    const int thread_counts[] = {1, 2, 4};
+
+    cout << "width,height,threads,cores,fps,update_p50_us,update_p99_us,preprocess_p50_us,search_p50_us,speedup,lane_diff_px" << endl;
+    for (const Size &size : sizes)
+    {
+        road.width = size.width;
+        road.height = size.height;
+        RoadGenerator generator(config_path, road);
+        std::vector<Mat> replay;
+        for (int i = 0; i < SYNTHETIC_FRAMES; i++)
+        {
+            replay.push_back(generator.render(i));
+        }
+
+        double single_p50 = 0;
+        std::vector<double> single_left(LANE_MAX_DEGREE), single_right(LANE_MAX_DEGREE);
+        for (int threads : thread_counts)
+        {
+            try
+            {
+                libconfig::Setting &detector = cfg.lookup("detector");
+                if (!detector.exists("threads")) detector.add("threads", libconfig::Setting::TypeInt);
+                detector["threads"] = threads;
+                cfg.writeFile(tmp_path);
+            }
+            catch(...)
+            {
+                cerr << "Invalid config file" << endl;
+                unlink(tmp_path);
+                return 1;
+            }
+            int cores = pin(allowed, threads);
+
+            size_t next = 0;
+            Detector detector(tmp_path, [&replay, &next]() {
+                return replay[next++ % replay.size()];
+            });
+            for (int i = 0; i < WARMUP_FRAMES; i++) detector.step();
+            metrics.reset();
+
+            auto begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++) detector.step();
+            auto end = std::chrono::steady_clock::now();
+            double fps = frames / std::chrono::duration<double>(end - begin).count();
+
+            Histogram::Summary update = update_ns.summarize();
+            const Lane &lane = detector.getLane();
+            double diff = 0;
+            if (threads == 1)
+            {
+                single_p50 = update.p50;
+                std::copy(lane.getLParams(), lane.getLParams() + lane.getDegree(), single_left.begin());
+                std::copy(lane.getRParams(), lane.getRParams() + lane.getDegree(), single_right.begin());
+            }
+            else
+            {
+                for (int y = 0; y < size.height; y++)
+                {
+                    diff = std::max(diff, std::abs(polynomial(lane.getLParams(), lane.getDegree(), y) -
+                                                   polynomial(&single_left[0], lane.getDegree(), y)));
+                    diff = std::max(diff, std::abs(polynomial(lane.getRParams(), lane.getDegree(), y) -
+                                                   polynomial(&single_right[0], lane.getDegree(), y)));
+                }
+            }
+
+            cout << size.width << "," << size.height << "," << threads << "," << cores << "," << fps << ","
+                 << update.p50 / 1000.0 << "," << update.p99 / 1000.0 << ","
+                 << preprocess_ns.summarize().p50 / 1000.0 << "," << search_ns.summarize().p50 / 1000.0 << ","
+                 << (double)single_p50 / update.p50 << "," << diff << endl;
+        }
+    }
+
+    pin(allowed, CPU_SETSIZE);
+    unlink(tmp_path);
+}
@@ -0,0 +1,155 @@
+#include "bitmask.h"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Packs a binary birdseye mask
+ * @param mask CV_8UC1 image, lane pixels are 255
+ * @param row_step pack only every row_step-th row counting up from the
+ *        bottom one, the rows Detector searches; the others are left as
+ *        they were
+ */
+void BitMask::pack(const cv::Mat &mask, int row_step)
+{
+    pack(mask.data, mask.step, mask.rows, mask.cols, row_step);
+}
+
+/**
+ * Packs a binary mask from raw rows of bytes
+ * @param data first byte of the first row
+ * @param step bytes between the starts of consecutive rows
+ * @param row_step see pack(const cv::Mat &, int)
+ */
+void BitMask::pack(const uint8_t *data, size_t step, int rows, int cols, int row_step)
+{
+    this->rows = rows;
+    this->cols = cols;
+    stride = (cols + 63) / 64;
+    words.resize((size_t)rows * stride);
+
+    for (int i = rows - 1; i >= 0; i -= row_step)
+    {
+        const uint8_t *src = data + i * step;
+        uint64_t *dst = &words[(size_t)i * stride];
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i set = _mm_set1_epi8((char)255);
+        for (; x + 64 <= cols; x += 64)
+        {
+            uint64_t word = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + x + 16 * k));
+                uint64_t bits = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, set));
+                word |= bits << (16 * k);
+            }
+            dst[x / 64] = word;
+        }
+#endif
+        for (; x < cols; x += 64)
+        {
+            uint64_t word = 0;
+            int n = std::min(64, cols - x);
+            for (int b = 0; b < n; b++)
+            {
+                word |= (uint64_t)(src[x + b] == 255) << b;
+            }
+            dst[x / 64] = word;
+        }
+    }
+}
+
+/**
+ * @return true if the pixel is set; false outside the image
+ */
+bool BitMask::test(int row, int col) const
+{
+    if (row < 0 || row >= rows || col < 0 || col >= cols) return false;
+    return (words[(size_t)row * stride + col / 64] >> (col % 64)) & 1;
+}
+
+/**
+ * Finds the set pixel closest to a column within a window of a row. Columns
+ * outside the image are never set. Of two pixels at the same distance the
+ * one on the `inner` side wins, which matches the order the byte-wise search
+ * probes in with a column stride of 1.
+ * @param row row to search
+ * @param center predicted column, may lie outside the image
+ * @param radius columns searched on each side of center
+ * @param inner +1 to prefer center + d over center - d, -1 for the opposite
+ * @return column of the closest set pixel, or -1 if the window has none
+ */
+int BitMask::nearest(int row, int center, int radius, int inner) const
+{
+    if (row < 0 || row >= rows) return -1;
+    int lo = std::max(0, center - radius);
+    int hi = std::min(cols - 1, center + radius);
+    if (lo > hi) return -1;
+
+    // Search the preferred side first, then the other one only as far as
+    // it could still hold a strictly closer pixel
+    const uint64_t *line = &words[(size_t)row * stride];
+    if (inner > 0)
+    {
+        int up = center <= hi ? nextSet(line, std::max(lo, center), hi) : -1;
+        if (up >= 0 && up == center) return up;
+        int limit = up >= 0 ? std::max(lo, 2 * center - up + 1) : lo;
+        int down = center > limit ? prevSet(line, std::min(hi, center - 1), limit) : -1;
+        return down >= 0 ? down : up;
+    }
+    else
+    {
+        int down = center >= lo ? prevSet(line, std::min(hi, center), lo) : -1;
+        if (down >= 0 && down == center) return down;
+        int limit = down >= 0 ? std::min(hi, 2 * center - down - 1) : hi;
+        int up = center < limit ? nextSet(line, std::max(lo, center + 1), limit) : -1;
+        return up >= 0 ? up : down;
+    }
+}
+
+/**
+ * @return first set column in [from, to], or -1
+ */
+int BitMask::nextSet(const uint64_t *line, int from, int to) const
+{
+    int w = from / 64;
+    int last = to / 64;
+    uint64_t bits = line[w] & (~0ULL << (from % 64));
+    while (true)
+    {
+        if (bits != 0)
+        {
+            int x = w * 64 + __builtin_ctzll(bits);
+            return x <= to ? x : -1;
+        }
+        if (++w > last) return -1;
+        bits = line[w];
+    }
+}
+
+/**
+ * @return last set column in [to, from], or -1
+ */
+int BitMask::prevSet(const uint64_t *line, int from, int to) const
+{
+    int w = from / 64;
+    int first = to / 64;
+    uint64_t bits = line[w] & (~0ULL >> (63 - from % 64));
+    while (true)
+    {
+        if (bits != 0)
+        {
+            int x = w * 64 + 63 - __builtin_clzll(bits);
+            return x >= to ? x : -1;
+        }
+        if (--w < first) return -1;
+        bits = line[w];
+    }
+}
+
+int BitMask::getRows() const { return rows; }
+int BitMask::getCols() const { return cols; }
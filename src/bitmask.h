@@ -0,0 +1,42 @@
+#ifndef BITMASK_H
+#define BITMASK_H
+
+#include "opencv2/opencv.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Binary birdseye mask packed to one bit per pixel, 64 pixels per word.
+ *
+ * A pixel is set if it is exactly 255 in the byte mask, the same test the
+ * byte-wise search in Detector makes. Packing compares 16 pixels at a time
+ * with SSE2 where available. Finding the nearest lane pixel to a predicted
+ * column then reads one or two words per side of the window and locates the
+ * closest set bit with a count of trailing or leading zeros, instead of
+ * probing the window a pixel at a time. Only the rows that will be searched
+ * need to be packed.
+ */
+class BitMask
+{
+public:
+    void pack(const cv::Mat &mask, int row_step = 1);
+    void pack(const uint8_t *data, size_t step, int rows, int cols, int row_step = 1);
+
+    bool test(int row, int col) const;
+    int nearest(int row, int center, int radius, int inner) const;
+
+    int getRows() const;
+    int getCols() const;
+
+private:
+    int rows = 0;
+    int cols = 0;
+    int stride = 0; // words per row
+    std::vector<uint64_t> words;
+
+    int nextSet(const uint64_t *line, int from, int to) const;
+    int prevSet(const uint64_t *line, int from, int to) const;
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include "capture.h"
+
+#include <iostream>
+#include <cstring>
+
+#define FAIL_LIMIT 100 // consecutive failed camera reads before the camera counts as failed
+
+/**
+ * Opens the camera and starts the capture thread.
+ * The first frame is grabbed synchronously so every slot can be allocated at
+ * the camera's native size before the thread starts writing.
+ * @param index camera index passed to cv::VideoCapture
+ * @param slots number of frames kept in the ring (at least 2)
+ */
+Capture::Capture(int index, int slots)
+    : cap(index), ring(slots < 2 ? 2 : slots), latest(0), running(false), failed(false),
+      captured(0), delivered(0), dropped(0), stale(0), retries(0), failures(0),
+      dropped_counter(Metrics::instance().counter("capture.dropped")),
+      stale_counter(Metrics::instance().counter("capture.stale")),
+      failures_counter(Metrics::instance().counter("capture.failures"))
+{
+    for (Slot &slot : ring)
+    {
+        slot.id = 0;
+        slot.seq = 0;
+    }
+
+    if (!cap.isOpened())
+    {
+        std::cerr << "Could not open camera " << index << std::endl;
+        return;
+    }
+
+    cv::Mat probe;
+    cap >> probe;
+    if (probe.empty())
+    {
+        std::cerr << "Camera " << index << " delivered no frame" << std::endl;
+        failed = true;
+        return;
+    }
+    for (Slot &slot : ring)
+    {
+        slot.frame.create(probe.size(), probe.type());
+    }
+
+    running = true;
+    capture_thread = new std::thread(&Capture::run, this);
+}
+
+Capture::~Capture()
+{
+    stop();
+    delete capture_thread;
+    cap.release();
+}
+
+bool Capture::isOpened() const
+{
+    return cap.isOpened();
+}
+
+/**
+ * @return true once the camera has failed to deliver FAIL_LIMIT frames in a
+ *         row; the capture thread has stopped and read() returns false
+ */
+bool Capture::isFailed() const
+{
+    return failed.load(std::memory_order_acquire);
+}
+
+/**
+ * Stops the capture thread. Frames already in the ring remain readable.
+ */
+void Capture::stop()
+{
+    running = false;
+    if (capture_thread != nullptr && capture_thread->joinable())
+    {
+        capture_thread->join();
+    }
+}
+
+/**
+ * Capture loop. Decodes each frame into a private buffer, then copies it into
+ * the slot after the newest one, so the slot a reader is most likely copying
+ * from is the last to be overwritten. Frames of another size or type than the
+ * first one count as failed reads.
+ */
+void Capture::run()
+{
+    const size_t bytes = ring[0].frame.total() * ring[0].frame.elemSize();
+    uint64_t next = 1;
+    int failed_in_row = 0;
+    while (running)
+    {
+        bool ok = cap.read(grabbed) && grabbed.size() == ring[0].frame.size() &&
+                  grabbed.type() == ring[0].frame.type();
+        Clock::time_point stamp = Clock::now();
+        if (!ok)
+        {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            failures_counter.add();
+            if (++failed_in_row >= FAIL_LIMIT)
+            {
+                std::cerr << "Camera stopped delivering frames" << std::endl;
+                failed.store(true, std::memory_order_release);
+                running = false;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        failed_in_row = 0;
+        if (!grabbed.isContinuous()) grabbed = grabbed.clone();
+
+        Slot &slot = ring[next % ring.size()];
+        slot.seq.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::memcpy(slot.frame.data, grabbed.data, bytes);
+        slot.stamp = stamp;
+        slot.id = next;
+
+        slot.seq.fetch_add(1, std::memory_order_release);
+
+        latest.store(next, std::memory_order_release);
+        captured.fetch_add(1, std::memory_order_relaxed);
+        next++;
+    }
+}
+
+/**
+ * Copies a slot out if the writer did not touch it during the copy. Only the
+ * bytes of the slot's buffer are read; its header never changes.
+ * @return true if the copy is consistent
+ */
+bool Capture::copySlot(const Slot &slot, cv::Mat &frame, Clock::time_point *stamp, uint64_t &id) const
+{
+    uint64_t before = slot.seq.load(std::memory_order_acquire);
+    if (before & 1) return false;
+
+    frame.create(slot.frame.size(), slot.frame.type());
+    std::memcpy(frame.data, slot.frame.data, slot.frame.total() * slot.frame.elemSize());
+    Clock::time_point when = slot.stamp;
+    id = slot.id;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != before) return false;
+
+    if (stamp != nullptr) *stamp = when;
+    return true;
+}
+
+/**
+ * Reads the newest captured frame. Only blocks until the very first frame has
+ * been captured; afterwards it returns immediately, possibly with the same
+ * frame as the previous call (counted as stale). Intended for a single reader.
+ * @param frame destination, reused if it already has the right size
+ * @param stamp optional capture time of the returned frame
+ * @return false if the camera failed (see isFailed()) or stopped before
+ *         delivering any frame
+ */
+bool Capture::read(cv::Mat &frame, Clock::time_point *stamp)
+{
+    if (isFailed()) return false;
+    while (latest.load(std::memory_order_acquire) == 0)
+    {
+        if (!running) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    uint64_t id;
+    while (true)
+    {
+        uint64_t newest = latest.load(std::memory_order_acquire);
+        if (copySlot(ring[newest % ring.size()], frame, stamp, id)) break;
+        retries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (id == last_read)
+    {
+        stale.fetch_add(1, std::memory_order_relaxed);
+        stale_counter.add();
+    }
+    else
+    {
+        dropped.fetch_add(id - last_read - 1, std::memory_order_relaxed);
+        dropped_counter.add(id - last_read - 1);
+        delivered.fetch_add(1, std::memory_order_relaxed);
+        last_read = id;
+    }
+    return true;
+}
+
+Capture::Stats Capture::getStats() const
+{
+    Stats stats;
+    stats.captured = captured.load(std::memory_order_relaxed);
+    stats.delivered = delivered.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.stale = stale.load(std::memory_order_relaxed);
+    stats.retries = retries.load(std::memory_order_relaxed);
+    stats.failures = failures.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,84 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "opencv2/opencv.hpp"
+#include "metrics.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/**
+ * Keeps a camera open on its own thread and publishes the newest frames
+ * through a fixed-size, preallocated, lock-free ring of timestamped slots.
+ *
+ * The writer never waits for readers: it decodes each frame into a private
+ * buffer and then copies its bytes into the slot after the most recently
+ * published one. Slot buffers are allocated once and never reallocated, so a
+ * reader copying bytes out under the slot's sequence number (seqlock) can at
+ * worst see a torn frame, which it detects and retries; it never touches
+ * memory the writer frees. Reads never block once the first frame has
+ * arrived. A camera that keeps failing to deliver frames is reported as
+ * failed and reads return false.
+ */
+class Capture
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stats
+    {
+        uint64_t captured;  // frames written into the ring
+        uint64_t delivered; // new frames handed to readers
+        uint64_t dropped;   // frames overwritten before any reader saw them
+        uint64_t stale;     // reads that returned an already delivered frame
+        uint64_t retries;   // reads repeated because the writer lapped the reader
+        uint64_t failures;  // camera reads that returned no usable frame
+    };
+
+    Capture(int index, int slots = 4);
+    virtual ~Capture();
+
+    bool isOpened() const;
+    bool isFailed() const;
+    bool read(cv::Mat &frame, Clock::time_point *stamp = nullptr);
+    void stop();
+    Stats getStats() const;
+
+private:
+    struct Slot
+    {
+        cv::Mat frame; // allocated in the constructor, only its bytes change afterwards
+        Clock::time_point stamp;
+        uint64_t id;
+        std::atomic<uint64_t> seq; // odd while the writer owns the slot
+    };
+
+    void run();
+    bool copySlot(const Slot &slot, cv::Mat &frame, Clock::time_point *stamp, uint64_t &id) const;
+
+    cv::VideoCapture cap;
+    cv::Mat grabbed; // decoded by the capture thread before it is copied into a slot
+    std::vector<Slot> ring;
+
+    std::atomic<uint64_t> latest; // id of the newest published frame, 0 if none
+    std::atomic<bool> running;
+    std::atomic<bool> failed; // the camera stopped delivering frames
+    std::thread *capture_thread = nullptr;
+
+    uint64_t last_read = 0; // id of the last frame handed to a reader
+    std::atomic<uint64_t> captured;
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> stale;
+    std::atomic<uint64_t> retries;
+    std::atomic<uint64_t> failures;
+
+    Counter &dropped_counter;
+    Counter &stale_counter;
+    Counter &failures_counter;
+};
+
+#endif
@@ -20,6 +20,7 @@ using namespace std;
 #include <unistd.h>
 #include <math.h>
 #include <chrono>
+#include <memory>
 
 #include "opencv2/opencv.hpp"
 
@@ -28,6 +29,9 @@ using namespace std;
 #include "detector.h"
 #include "helpers.h"
 #include "pid.h"
+#include "capture.h"
+#include "metrics.h"
+#include "telemetry.h"
 
 #define TIMEOUT 500
 using namespace cv;
@@ -41,13 +45,17 @@ int main(int argc, char* argv[])
         return 0;
     }
     string config_path(argv[1]);
+    Metrics::instance().configure(config_path);
 
     std::function<Mat()> get_frame;
     string serial_port;
     int serial_baud;
     SerialCommunication *serial = nullptr;
+    Capture *capture = nullptr;
     bool show_output = false;
 
+    LDMapLog ldmap_log(config_path);
+
     double Kp = 0.0;
     double Ki = 0.0;
     double Kd = 0.0;
@@ -64,15 +72,20 @@ int main(int argc, char* argv[])
             std::cout << Kp << " " << Ki << " " << Kd << std::endl;
         }
 
+        if (cfg.exists("detector.threads") && (int)cfg.lookup("detector.threads") > 1)
+        {
+            // One level of parallelism: OpenCV's own threads would compete with the detector's pool
+            cv::setNumThreads(1);
+        }
+
         if (cfg.exists("video.index")) 
         {
             int index = cfg.lookup("video.index");
-            get_frame = std::function<Mat()>([index](){
-                            VideoCapture cap(index);
-                            // cap.set(CV_CAP_PROP_OPENNI_MAX_BUFFER_SIZE, 1);
+            capture = new Capture(index);
+            // A failed camera returns an empty frame, which ends the detection loop
+            get_frame = std::function<Mat()>([capture](){
                             Mat frame;
-                            cap >> frame;
-                            cap.release();
+                            if (!capture->read(frame)) frame.release();
                             return frame;
                         });
         } 
@@ -80,10 +93,10 @@ int main(int argc, char* argv[])
         {
             std::string path(cfg.lookup("video.file").c_str());
             path = abs_path(path, get_dir(config_path));
-            get_frame = std::function<Mat()>([path](){
-                            static VideoCapture cap(path);
+            auto cap = std::make_shared<VideoCapture>(path);
+            get_frame = std::function<Mat()>([cap](){
                             Mat frame;
-                            cap >> frame;
+                            *cap >> frame;
                             return frame;
                       });
         }
@@ -98,8 +111,10 @@ int main(int argc, char* argv[])
             serial_port = cfg.lookup("serial.port").c_str();
             serial_baud = cfg.lookup("serial.baud");
             serial = new SerialCommunication(serial_port, serial_baud);
-            serial->register_callback([](const LDMap& ldmap){
+            serial->register_callback([&ldmap_log](const LDMap& ldmap){
                 // std::cout << "orientation: " << ldmap.orientation << std::endl;
+                ldmap_log.append(ldmap, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
             });
         }
     }
@@ -110,8 +125,6 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    Mat frame = get_frame();
-
     if (serial != nullptr) 
     {
         serial->run();
@@ -123,9 +136,24 @@ int main(int argc, char* argv[])
     }
     
     Detector detector(config_path, get_frame);
+    TelemetryLog telemetry(config_path);
 
     PID pid(TIMEOUT / 1000.0, 10.0, -10.0, Kp, Kd, Ki);
-    detector.start(1.0/(TIMEOUT / 1000.0), [&detector, serial, &pid, show_output] (const Lane &lane) {
+    Histogram &pid_ns = Metrics::instance().histogram("pid.calculate_ns");
+    int64_t last_ns = 0;
+    detector.start(1.0/(TIMEOUT / 1000.0), [&detector, serial, &pid, &pid_ns, &telemetry, &last_ns, show_output] (const Lane &lane) {
+        // Cycles stretch when the scheduler skips periods, so the PID gets the
+        // measured interval, on the steady clock: the system clock can step
+        // (NTP, RTC) and only stamps the telemetry. Taken before the frame is
+        // shown so this cycle's imshow() is not counted. replay repeats this
+        // from the logged steady_ns.
+        int64_t steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        double dt = PID::interval(last_ns, steady_ns, TIMEOUT / 1000.0);
+        last_ns = steady_ns;
+
         if (show_output)
         {
             cv::imshow("output", detector.drawLane());
@@ -134,19 +162,54 @@ int main(int argc, char* argv[])
 
         // TEST 2
         double radius = detector.getTurningRadius();
-        double angle = pid.calculate(0.0, 1 / radius); // one over radius since a greater radius means less control value
+        double angle;
+        {
+            ScopedTimer timer(pid_ns);
+            angle = pid.calculate(0.0, 1 / radius, dt); // one over radius since a greater radius means less control value
+        }
         
+        UARTCommand command { 
+            .maxTime = TIMEOUT,
+            .speed = 10, 
+            .orientation = (int16_t)angle, 
+            .distance = 200,
+            .dir = 1
+        };
         if (serial != nullptr)
         {
-            UARTCommand command { 
-                .maxTime = TIMEOUT,
-                .speed = 10, 
-                .orientation = (int16_t)angle, 
-                .distance = 200,
-                .dir = 1
-            };
             serial->sendCommand(command);
         }
+
+        TelemetryRecord *record = telemetry.next();
+        if (record != nullptr)
+        {
+            Detector::Hits hits = detector.getHits();
+            Detector::SearchStats search = detector.getSearchStats();
+            record->time_ns = now_ns;
+            record->steady_ns = steady_ns;
+            record->degree = lane.getDegree();
+            record->hits_left = hits.left;
+            record->hits_right = hits.right;
+            record->window_left = search.left.threshold;
+            record->window_right = search.right.threshold;
+            record->pixel_reads = search.reads;
+            record->confidence_left = search.confidence_left;
+            record->confidence_right = search.confidence_right;
+            std::copy(lane.getLParams(), lane.getLParams() + LANE_MAX_DEGREE, record->left);
+            std::copy(lane.getRParams(), lane.getRParams() + LANE_MAX_DEGREE, record->right);
+            std::copy(lane.getParams(), lane.getParams() + LANE_MAX_DEGREE, record->center);
+            record->radius = radius;
+            record->pid = angle;
+            record->command_sent = serial != nullptr;
+            record->command = command;
+            telemetry.commit();
+        }
     });
     detector.join();
+
+    if (capture != nullptr && capture->isFailed())
+    {
+        cerr << "Stopped: camera failed after " << capture->getStats().captured << " frames" << endl;
+        return 1;
+    }
 }
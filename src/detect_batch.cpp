@@ -0,0 +1,114 @@
+/**
+ * detect_batch.cpp
+ * Detects the lane in every frame of a recorded video with BatchDetector,
+ * which measures many frames in parallel and filters the lane in order, and
+ * reports the throughput.
+ *
+ * Usage: detect_batch <config file> <video file> [sequential]
+ *   sequential: also run Detector::step() frame by frame on the same video
+ *               and compare speed and lanes
+ *
+ * The hash folds the left and right lane of every frame; both runs give the
+ * same hash. Preprocessing runs in parallel and the search in frame order,
+ * so the sequential stage time bounds the speedup.
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <libconfig.h++>
+
+#include "opencv2/opencv.hpp"
+
+#include "batch.h"
+#include "detector.h"
+#include "helpers.h"
+
+using namespace cv;
+
+/**
+ * Folds the lane lines into a 64 bit FNV-1a hash
+ */
+void hash_lane(uint64_t &hash, const Lane &lane)
+{
+    fnv1a(hash, lane.getLParams(), LANE_MAX_DEGREE * sizeof(double));
+    fnv1a(hash, lane.getRParams(), LANE_MAX_DEGREE * sizeof(double));
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cout << "Usage: " << argv[0] << " <config file> <video file> [sequential]" << endl;
+        return 0;
+    }
+    string config_path(argv[1]);
+    string video_path(argv[2]);
+    bool sequential = argc > 3 && string(argv[3]) == "sequential";
+
+    VideoCapture cap(video_path);
+    if (!cap.isOpened())
+    {
+        cerr << "Could not open " << video_path << endl;
+        return 1;
+    }
+
+    uint64_t hash = FNV_OFFSET;
+    unique_ptr<BatchDetector> batch;
+    try
+    {
+        batch.reset(new BatchDetector(config_path, [&cap]() {
+            Mat frame;
+            cap >> frame;
+            return frame;
+        }));
+    }
+    catch(...)
+    {
+        return 1;
+    }
+    if (batch->getThreads() > 1)
+    {
+        // Frames are the unit of parallelism; OpenCV's own threads would compete
+        cv::setNumThreads(1);
+    }
+    batch->run([&hash](const Lane &lane) { hash_lane(hash, lane); });
+    BatchDetector::Stats stats = batch->getStats();
+    double fps = stats.frames / (stats.wall_ms / 1000);
+
+    cout << "threads: " << batch->getThreads() << endl;
+    cout << "depth: " << batch->getDepth() << endl;
+    cout << "frames: " << stats.frames << endl;
+    cout << "wall: " << stats.wall_ms / 1000 << " s (" << stats.read_ms / 1000 << " s reading)" << endl;
+    cout << "parallel stage: " << stats.measure_ms / 1000 << " s" << endl;
+    cout << "sequential stage: " << stats.commit_ms / 1000 << " s" << endl;
+    cout << "frames/s: " << fps << endl;
+    cout << "hash: " << hash_hex(hash) << endl;
+
+    if (!sequential) return 0;
+
+    // Same frames one at a time; a worker detector so nothing is recorded
+    VideoCapture replay(video_path);
+    Detector detector(config_path, [&replay]() {
+        Mat frame;
+        replay >> frame;
+        return frame;
+    }, true);
+    uint64_t sequential_hash = FNV_OFFSET;
+    uint64_t frames = 0;
+    auto begin = std::chrono::steady_clock::now();
+    while (detector.step())
+    {
+        hash_lane(sequential_hash, detector.getLane());
+        frames++;
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    cout << "sequential frames/s: " << frames / wall_s << endl;
+    cout << "speedup: " << fps / (frames / wall_s) << "x" << endl;
+    cout << "sequential hash: " << hash_hex(sequential_hash)
+         << (sequential_hash == hash ? " (same)" : " (differs)") << endl;
+}
@@ -1,7 +1,9 @@
 using namespace std;
 
 #include "detector.h"
-#include "polifitgsl.h"
+#include "fixedfit.h"
+#include "polynomial.h"
+#include "spsc.h"
 #include "helpers.h"
 
 #include <libconfig.h++>
@@ -14,19 +16,48 @@ using namespace std;
 #include <chrono>
 #include <future>
 
+#define OVERLAY_ROWS 32 // segments per lane line drawn by drawLane()
+#define CONFIDENT 0.75  // adaptive search: above this, halve the window and probe every other row
+#define UNSURE 0.25     // adaptive search: below this, widen the window and halve the column stride
+#define CORRIDOR 2      // pyramid: full resolution columns searched per side, per unit of downscaling
+#define STRIPE_BYTES (64 * 1024) // camera frame bytes per preprocessing stripe, about half an L2 cache
+
 using namespace cv;
 
 using namespace std::literals::chrono_literals;
-//-----CLASS METHOD DECLARATIONS-----//
-
-double polynomial(std::vector<double> params, double x);
-void thresh(const cv::Mat &src, cv::Mat &dst, int threshold);
-
 //-----CLASS METHODS-----//
 
-Detector::Detector(string config_path, std::function<cv::Mat()> get_frame)
-    : get_frame(get_frame)
+/**
+ * @param config_path path to config file
+ * @param get_frame source of frames; called once here for the frame size
+ * @param worker only prepares frames for another Detector (see prepare()):
+ *        never records and does not split frames across threads
+ */
+Detector::Detector(string config_path, std::function<cv::Mat()> get_frame, bool worker)
+    : get_frame(get_frame),
+      update_ns(Metrics::instance().histogram("detector.update_ns")),
+      preprocess_ns(Metrics::instance().histogram("detector.preprocess_ns")),
+      search_ns(Metrics::instance().histogram("detector.search_ns")),
+      coarse_ns(Metrics::instance().histogram("detector.coarse_ns")),
+      fit_ns(Metrics::instance().histogram("detector.fit_ns")),
+      draw_ns(Metrics::instance().histogram("detector.draw_lane_ns")),
+      hits_left(Metrics::instance().histogram("detector.hits_left")),
+      hits_right(Metrics::instance().histogram("detector.hits_right")),
+      pixel_reads(Metrics::instance().histogram("detector.pixel_reads")),
+      window_left(Metrics::instance().histogram("detector.window_left")),
+      window_right(Metrics::instance().histogram("detector.window_right")),
+      frames_counter(Metrics::instance().counter("detector.frames")),
+      fits_skipped(Metrics::instance().counter("detector.fits_skipped"))
 {
+    for (StageCounters &counters : stage_counters)
+    {
+        counters.frames = 0;
+        counters.busy_ns = 0;
+        counters.stall_ns = 0;
+        counters.occupancy = 0;
+        counters.samples = 0;
+    }
+
     libconfig::Config cfg;
     try
     {
@@ -36,6 +67,11 @@ Detector::Detector(string config_path, std::function<cv::Mat()> get_frame)
         col_step = cfg.lookup("detector.col_step");
         l_start = cfg.lookup("detector.start.left");
         r_start = cfg.lookup("detector.start.right");
+        next_left = next_right = Window{threshold, 1, col_step};
+        if (cfg.exists("detector.adaptive"))
+        {
+            adaptive = cfg.lookup("detector.adaptive");
+        }
 
         img_threshold = cfg.lookup("camera.threshold");
         double cam_angle = cfg.lookup("camera.angle");
@@ -48,17 +84,116 @@ Detector::Detector(string config_path, std::function<cv::Mat()> get_frame)
         cv::Mat frame = get_frame();
         frame_height = frame.rows; 
         frame_width = frame.cols; 
-        out = cv::VideoWriter("output.avi", CV_FOURCC('M', 'P', 'E', 'G'), 2, Size(frame_width, frame_height));
 
 
         m_per_px = (double)cfg.lookup("camera.range") / frame_height;
 
         matrix_transform_birdseye = getTransformMatrix(frame_height, frame_width, cam_angle, frame_floor, frame_ceiling);
         matrix_transform_fiperson = getTransformMatrix(frame_height, frame_width, cam_angle, frame_floor, frame_ceiling, true); 
+
+        if (cfg.exists("detector.pipeline"))
+        {
+            pipelined = cfg.lookup("detector.pipeline");
+        }
+
+        if (cfg.exists("detector.overrun"))
+        {
+            overrun_policy = RateScheduler::parsePolicy(cfg.lookup("detector.overrun").c_str());
+        }
+
+        if (!worker && cfg.exists("record"))
+        {
+            recorder = new Recorder(config_path);
+            if (!recorder->isEnabled())
+            {
+                delete recorder;
+                recorder = nullptr;
+            }
+        }
+
+        if (cfg.exists("detector.sparse") && (bool)cfg.lookup("detector.sparse"))
+        {
+            sampler = new SparseSampler(matrix_transform_fiperson, frame_width, frame_height, img_threshold);
+        }
+        else if (cfg.exists("detector.preprocess") && std::string(cfg.lookup("detector.preprocess").c_str()) == "remap")
+        {
+            preprocessor = new Preprocessor(matrix_transform_birdseye, frame_width, frame_height, img_threshold);
+        }
+
+        if (sampler == nullptr && cfg.exists("detector.pyramid"))
+        {
+            pyramid = std::max(0, (int)cfg.lookup("detector.pyramid"));
+            pyramid_scale = 1 << pyramid;
+        }
+
+        if (sampler == nullptr && pyramid == 0 && cfg.exists("detector.bitmask"))
+        {
+            use_bitmask = cfg.lookup("detector.bitmask");
+        }
+
+        int threads = cfg.exists("detector.threads") ? (int)cfg.lookup("detector.threads") : 1;
+        if (!worker && threads > 1)
+        {
+            pool = new TaskPool(threads);
+            matrix_inverse_birdseye = matrix_transform_birdseye.inv();
+            stripe_rows = std::max(8, STRIPE_BYTES / (frame_width * 3));
+        }
     
-        lane = new Lane(config_path, 
-                    {(double)frame_width * l_start / 100, 0, 0},  // initial lparams
-                    {(double)frame_width * r_start / 100, 0, 0}); // initial rparams
+        int degree = cfg.exists("lane.n") ? (int)cfg.lookup("lane.n") : 3;
+        degree = std::min(std::max(degree, 1), LANE_MAX_DEGREE);
+        std::vector<double> lparams(degree, 0.0);
+        std::vector<double> rparams(degree, 0.0);
+        lparams[0] = (double)frame_width * l_start / 100;
+        rparams[0] = (double)frame_width * r_start / 100;
+        lane = new Lane(config_path, lparams, rparams);
+        current = lane;
+
+        std::string estimator = "filter";
+        cfg.lookupValue("lane.estimator", estimator);
+        if (estimator == "rls")
+        {
+            double forgetting = 0.9;
+            cfg.lookupValue("lane.forgetting", forgetting);
+            lfit = LaneFitter::createRecursive(lane->getDegree(), frame_height, row_step, forgetting);
+            rfit = LaneFitter::createRecursive(lane->getDegree(), frame_height, row_step, forgetting);
+            // The estimator smooths over frames itself (lane.forgetting)
+            lane->setFilter(0);
+        }
+        else
+        {
+            lfit = LaneFitter::create(lane->getDegree(), frame_height, row_step);
+            rfit = LaneFitter::create(lane->getDegree(), frame_height, row_step);
+        }
+
+        if (pyramid > 0)
+        {
+            int coarse_height = frame_height / pyramid_scale;
+            coarse_step = std::max(1, row_step / pyramid_scale);
+            matrix_transform_coarse = getTransformMatrix(coarse_height, frame_width / pyramid_scale,
+                    cam_angle, frame_floor, frame_ceiling);
+            refiner = new SparseSampler(matrix_transform_fiperson, frame_width, frame_height, img_threshold);
+            coarse_lfit = LaneFitter::create(lane->getDegree(), coarse_height, coarse_step);
+            coarse_rfit = LaneFitter::create(lane->getDegree(), coarse_height, coarse_step);
+        }
+
+        // Rows searched by update(), in fitter slot order
+        search_rows.push_back(frame_height);
+        for (int i = frame_height-1; i >= 0; i-=row_step)
+        {
+            search_rows.push_back(i);
+        }
+        search_left.resize(search_rows.size());
+        search_right.resize(search_rows.size());
+        for (std::vector<int> *slots : {&hit_slots_left, &hit_slots_right}) slots->reserve(search_rows.size());
+        for (std::vector<double> *xs : {&hit_left, &hit_right}) xs->reserve(search_rows.size());
+
+        // Rows drawn by drawLane(), evenly spaced from the top to the bottom edge
+        for (int i = 0; i <= OVERLAY_ROWS; i++)
+        {
+            overlay_rows.push_back((double)frame_height * i / OVERLAY_ROWS);
+        }
+        overlay_left.resize(overlay_rows.size());
+        overlay_right.resize(overlay_rows.size());
     }
     catch(...)
     {
@@ -69,14 +204,28 @@ Detector::Detector(string config_path, std::function<cv::Mat()> get_frame)
 Detector::~Detector()
 {
     delete detect_thread;
+    delete pool;
+    delete recorder;
+    delete scheduler;
     delete lane;
+    delete preprocessor;
+    delete sampler;
+    delete refiner;
+    delete coarse_lfit;
+    delete coarse_rfit;
+    delete lfit;
+    delete rfit;
 }
 
 void Detector::start(double freq_hz, std::function<void(const Lane &lane)> callback)
 {
     if (detect_thread == nullptr)
     {
-        detect_thread = new std::thread(&Detector::detect, this, freq_hz, callback);
+        this->freq_hz = freq_hz;
+        scheduler = new RateScheduler(freq_hz, overrun_policy);
+        detect_thread = pipelined
+            ? new std::thread(&Detector::detectPipelined, this, callback)
+            : new std::thread(&Detector::detect, this, callback);
     }
 }
 
@@ -88,136 +237,734 @@ void Detector::join()
     }
 }
 
-void Detector::detect(double freq_hz, std::function<void(const Lane &lane)> callback)
+void Detector::detect(std::function<void(const Lane &lane)> callback)
 {
-    auto dt = std::chrono::duration<double>(1.0/freq_hz);
-    auto end = std::chrono::high_resolution_clock::now() + dt;
-
-    while (true)
+    scheduler->start();
+    while (step())
     {           
-        update(get_frame());       
         callback(*lane);
-        std::this_thread::sleep_until(end);
-        end = std::chrono::high_resolution_clock::now() + dt;
+        scheduler->wait();
+    }
+}
+
+namespace
+{
+    typedef std::chrono::steady_clock PipelineClock;
+
+    // A frame moving through the pipeline, with the buffers each stage fills
+    struct Work
+    {
+        cv::Mat frame;
+        cv::Mat gray;
+        cv::Mat mask;
+        BitMask bits;
+        Lane *lane; // lane after this frame was searched
+        Detector::Hits hits;
+        Detector::SearchStats search;
+    };
+
+    uint64_t elapsed_ns(PipelineClock::time_point since)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(PipelineClock::now() - since).count();
+    }
+}
+
+/**
+ * Takes a frame from a stage's input queue, waiting if it is empty
+ */
+template <typename T, typename Counters>
+static void pop_wait(SpscQueue<T> &queue, T &item, Counters &counters)
+{
+    counters.occupancy += queue.size();
+    counters.samples++;
+    if (queue.pop(item)) return;
+
+    auto begin = PipelineClock::now();
+    while (!queue.pop(item))
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    counters.stall_ns += elapsed_ns(begin);
+}
+
+/**
+ * Hands a frame to the next stage, waiting if its queue is full
+ */
+template <typename T, typename Counters>
+static void push_wait(SpscQueue<T> &queue, const T &item, Counters &counters)
+{
+    if (queue.push(item)) return;
+
+    auto begin = PipelineClock::now();
+    while (!queue.push(item))
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    counters.stall_ns += elapsed_ns(begin);
+}
+
+/**
+ * Detection loop split into three threads connected by bounded SPSC queues:
+ * capture + preprocess, search + fit + lane update, and the callback. Frame
+ * k+1 is preprocessed while frame k is searched and frame k-1 is reported.
+ * Each stage is a single thread and the queues are FIFO, so frames stay in
+ * order and the lane filter sees them sequentially, exactly as in detect().
+ * The callback gets a snapshot of the lane taken right after its own frame.
+ */
+void Detector::detectPipelined(std::function<void(const Lane &lane)> callback)
+{
+    const int depth = 4; // frames in flight, including the ones waiting in queues
+
+    std::vector<Work> pool(depth);
+    SpscQueue<Work*> free_queue(depth);
+    SpscQueue<Work*> preprocessed(depth);
+    SpscQueue<Work*> searched(depth);
+    for (Work &work : pool)
+    {
+        work.lane = new Lane(*lane);
+        free_queue.push(&work);
     }
 
+    std::thread searcher([&]() {
+        StageCounters &counters = stage_counters[STAGE_SEARCH];
+        Work *work;
+        while (true)
+        {
+            pop_wait(preprocessed, work, counters);
+            if (!work->frame.empty())
+            {
+                auto begin = PipelineClock::now();
+                search(work->frame, work->mask, work->bits);
+                *work->lane = *lane;
+                work->hits = search_hits;
+                work->search = search_stats;
+                counters.busy_ns += elapsed_ns(begin);
+                counters.frames++;
+            }
+            push_wait(searched, work, counters);
+            if (work->frame.empty()) break;
+        }
+    });
+
+    std::thread notifier([&]() {
+        StageCounters &counters = stage_counters[STAGE_CALLBACK];
+        Work *work;
+        while (true)
+        {
+            pop_wait(searched, work, counters);
+            if (work->frame.empty()) break;
+
+            auto begin = PipelineClock::now();
+            frame = work->frame;
+            current = work->lane;
+            current_hits = work->hits;
+            current_stats = work->search;
+            record(work->mask);
+            callback(*work->lane);
+            counters.busy_ns += elapsed_ns(begin);
+            counters.frames++;
+
+            push_wait(free_queue, work, counters);
+        }
+    });
+
+    StageCounters &counters = stage_counters[STAGE_PREPROCESS];
+    scheduler->start();
+    Work *work;
+    while (true)
+    {
+        pop_wait(free_queue, work, counters);
+
+        auto begin = PipelineClock::now();
+        work->frame = get_frame();
+        if (work->frame.empty())
+        {
+            push_wait(preprocessed, work, counters);
+            break;
+        }
+        preprocess(work->frame, work->gray, work->mask, work->bits);
+        counters.busy_ns += elapsed_ns(begin);
+        counters.frames++;
+
+        push_wait(preprocessed, work, counters);
+        scheduler->wait();
+    }
+
+    searcher.join();
+    notifier.join();
+
+    current = lane;
+    for (Work &work : pool)
+    {
+        delete work.lane;
+    }
+}
+
+/**
+ * Gets period, jitter and overrun statistics of the detection loop
+ * @return statistics since start(), all zero before it
+ */
+RateScheduler::Stats Detector::getSchedulerStats() const
+{
+    if (scheduler == nullptr) return RateScheduler::Stats();
+    return scheduler->getStats();
+}
+
+/**
+ * Gets timing counters for one stage of the detection loop. Only the
+ * pipelined loop (detector.pipeline = true) records them.
+ * @param stage stage to report
+ * @return counters accumulated since the detector was created
+ */
+Detector::StageStats Detector::getStageStats(Stage stage) const
+{
+    const StageCounters &counters = stage_counters[stage];
+    uint64_t samples = counters.samples;
+
+    StageStats stats;
+    stats.frames = counters.frames;
+    stats.busy_ms = counters.busy_ns / 1e6;
+    stats.stall_ms = counters.stall_ns / 1e6;
+    stats.occupancy = samples > 0 ? (double)counters.occupancy / samples : 0;
+    return stats;
+}
+
+/**
+ * Runs one detection cycle on the next frame
+ * @return false if no frame was available
+ */
+bool Detector::step()
+{
+    frame = get_frame();
+    if (frame.empty()) return false;
+    update(frame);
+    current_hits = search_hits;
+    current_stats = search_stats;
+    record(dst);
+    return true;
+}
+
+/**
+ * Preprocesses a frame into this detector's own buffers for another detector
+ * to search with commit(). The mask does not depend on the lane, so
+ * detectors with their own buffers can prepare consecutive frames in
+ * parallel.
+ * @param frame frame from video
+ */
+void Detector::prepare(const cv::Mat &frame)
+{
+    this->frame = frame;
+    preprocess(frame, th, dst, bits);
+}
+
+/**
+ * Finishes the detection cycle of a frame prepared by another detector, as
+ * step() would: searches its mask around the current lane, fits and filters
+ * the hits into the lane. The lane is the same as with step().
+ * @param prepared detector that preprocessed the next frame
+ */
+void Detector::commit(const Detector &prepared)
+{
+    frame = prepared.frame;
+    search(prepared.frame, prepared.dst, prepared.bits);
+    current_hits = search_hits;
+    current_stats = search_stats;
+    record(prepared.dst);
+}
+
+/**
+ * Hands the current frame, its birdseye mask and, if recorded, its overlay
+ * to the recorder. Does nothing unless the config has a record section.
+ * @param mask thresholded birdseye image of the frame, empty in sparse mode
+ */
+void Detector::record(const cv::Mat &mask)
+{
+    if (recorder == nullptr || !recorder->nextFrame()) return;
+
+    recorder->push(Recorder::RAW, frame);
+    recorder->push(Recorder::BIRDSEYE, mask);
+    if (recorder->isEnabled(Recorder::OVERLAY))
+    {
+        recorder->push(Recorder::OVERLAY, drawLane());
+    }
+}
+
+/**
+ * Gets encoded and dropped frame counts of one recorded stream
+ * @return all zero if recording is disabled
+ */
+Recorder::Stats Detector::getRecorderStats(Recorder::Stream stream) const
+{
+    if (recorder == nullptr) return Recorder::Stats{0, 0};
+    return recorder->getStats(stream);
 }
 
 /**
  * Get lanes
- * @param img processed (thresholded and warped to birdseye perpective) frame from video
- * @param lane Detected lane
+ * @param frame frame from video
  */
 void Detector::update(const cv::Mat &frame)
 {          
-    static cv::Mat th;
-    static cv::Mat dst;
-    static int width = frame_width;
-    static int height = frame_height;
-    static std::vector<double> lx;
-    static std::vector<double> rx;
-    static std::vector<double> ly;
-    static std::vector<double> ry;
-    static int degree = lane->getDegree();
+    ScopedTimer timer(update_ns);
+    preprocess(frame, th, dst, bits);
+    search(frame, dst, bits);
+}
+
+/**
+ * Thresholds a frame and warps it to birdseye perspective. Does nothing in
+ * sparse mode, where search() reads the frame directly. In pyramid mode the
+ * mask is built from the frame downscaled by 2^detector.pyramid.
+ * @param frame frame from video
+ * @param gray destination for the thresholded frame
+ * @param mask destination for the thresholded birdseye image
+ * @param packed destination for the bit-packed mask, filled in bitmask mode only
+ */
+void Detector::preprocess(const cv::Mat &frame, cv::Mat &gray, cv::Mat &mask, BitMask &packed)
+{
+    if (sampler != nullptr) return;
+    ScopedTimer timer(preprocess_ns);
+
+    if (pyramid > 0)
+    {
+        // mask holds the downscaled frame until it is overwritten by the warp
+        cv::Size size(frame_width / pyramid_scale, frame_height / pyramid_scale);
+        cv::resize(frame, mask, size, 0, 0, cv::INTER_AREA);
+        thresh(mask, gray, img_threshold);
+        cv::warpPerspective(gray, mask, matrix_transform_coarse, size);
+    }
+    else if (preprocessor != nullptr)
+    {
+        preprocessor->apply(frame, mask);
+    }
+    else if (pool != nullptr)
+    {
+        preprocessStriped(frame, gray, mask);
+    }
+    else
+    {
+        thresh(frame, gray, img_threshold);
+        cv::warpPerspective(gray, mask, matrix_transform_birdseye, Size(frame_width, frame_height));
+    }
+
+    if (use_bitmask)
+    {
+        packed.pack(mask, row_step);
+    }
+}
+
+/**
+ * thresh() and warpPerspective() split into horizontal stripes run on the
+ * task pool: grayscale, then blur and threshold, then the warp of each band
+ * of output rows. The blur of a stripe reads the rows around it from the
+ * full grayscale image, so the result matches the unstriped path.
+ * @param frame frame from video
+ * @param gray destination for the thresholded frame
+ * @param mask destination for the thresholded birdseye image
+ */
+void Detector::preprocessStriped(const cv::Mat &frame, cv::Mat &gray, cv::Mat &mask)
+{
+    const int stripes = (frame_height + stripe_rows - 1) / stripe_rows;
+    auto band = [this](int stripe) {
+        int begin = stripe * stripe_rows;
+        return cv::Range(begin, std::min(frame_height, begin + stripe_rows));
+    };
+
+    // mask holds the unblurred grayscale frame until the warp overwrites it
+    gray.create(frame_height, frame_width, CV_8UC1);
+    mask.create(frame_height, frame_width, CV_8UC1);
+    pool->parallelFor(stripes, [&](int stripe) {
+        cv::Mat dst = mask.rowRange(band(stripe));
+        cv::cvtColor(frame.rowRange(band(stripe)), dst, CV_BGR2GRAY);
+    });
+    pool->parallelFor(stripes, [&](int stripe) {
+        cv::Mat dst = gray.rowRange(band(stripe));
+        cv::GaussianBlur(mask.rowRange(band(stripe)), dst, Size( 7, 7 ), 1.5, 1.5 );
+        cv::threshold(dst, dst, img_threshold, 255, THRESH_BINARY);
+    });
+    pool->parallelFor(stripes, [&](int stripe) {
+        // Output rows [begin, end) are rows [0, end - begin) of a warp whose
+        // inverse map is shifted down by begin
+        cv::Range rows = band(stripe);
+        cv::Mat shifted = matrix_inverse_birdseye.clone();
+        for (int r = 0; r < 3; r++)
+        {
+            shifted.at<double>(r, 2) += rows.start * shifted.at<double>(r, 1);
+        }
+        cv::Mat dst = mask.rowRange(rows);
+        cv::warpPerspective(gray, dst, shifted, dst.size(), INTER_LINEAR | WARP_INVERSE_MAP);
+    });
+}
+
+/**
+ * Searches for lane pixels around the current lane and updates the lane
+ * @param frame frame from video (read in sparse mode)
+ * @param mask thresholded birdseye image from preprocess() (read otherwise)
+ * @param packed bit-packed mask from preprocess() (read instead of mask in bitmask mode)
+ */
+void Detector::search(const cv::Mat &frame, const cv::Mat &mask, const BitMask &packed)
+{
+    bool solved[2] = {false, false};
+    double fits[2][LANE_MAX_DEGREE];
+    searchLines(frame, mask, packed, solved, fits);
+    fitLines(pool == nullptr, solved, fits);
+}
+
+/**
+ * Finds the lane pixels of a frame around the current lane, leaving them in
+ * the hit vectors and in lfit and rfit, after the predicted bottom point.
+ * With a task pool the lines are fitted too.
+ * @param frame frame from video (read in sparse mode)
+ * @param mask thresholded birdseye image from preprocess() (read otherwise)
+ * @param packed bit-packed mask from preprocess() (read instead of mask in bitmask mode)
+ * @param solved receives whether each line was fitted (task pool only)
+ * @param fits receives the fit of each line (task pool only)
+ */
+void Detector::searchLines(const cv::Mat &frame, const cv::Mat &mask, const BitMask &packed,
+                           bool *solved, double (*fits)[LANE_MAX_DEGREE])
+{
+    const int height = frame_height;
+    const int degree = lane->getDegree();
+
+    // When the scheduler is degrading, sample every 2^level-th row and column
+    const int factor = scheduler != nullptr ? 1 << scheduler->getLevel() : 1;
+    const int rstep = row_step * factor;
+
+    SearchStats &stats = search_stats;
+    stats.left = next_left;
+    stats.right = next_right;
+    stats.left.col_step *= factor;
+    stats.right.col_step *= factor;
+    stats.rows_left = 0;
+    stats.rows_right = 0;
+    stats.reads = 0;
+    hit_slots_left.clear();
+    hit_left.clear();
+    hit_slots_right.clear();
+    hit_right.clear();
     
-    // Preprocesstry
-    thresh(frame, th, img_threshold);
-    cv::warpPerspective(th, dst, matrix_transform_birdseye, Size(width, height));
-
-    lx.push_back(polynomial(lane->getLParams(), height));
-    ly.push_back(height);
-    rx.push_back(polynomial(lane->getRParams(), height));
-    ry.push_back(height);
-
-    // Loop through frame rows at row_step
-    for (int i = height-1; i >= 0; i-=row_step)
-    {
-        int left = polynomial(lane->getLParams(), i); 
-        int right = polynomial(lane->getRParams(), i);
-        bool found_left = false;
-        bool found_right = false;
-        for (int j = 0; j <= threshold; j+=col_step)
+    // Predicted lane columns for every searched row
+    lanePositions(lane->getLParams(), lane->getRParams(), degree,
+                  &search_rows[0], search_rows.size(), &search_left[0], &search_right[0]);
+
+    // Pyramid: fit the coarse mask, then only search narrow corridors around
+    // that fit at full resolution. Without a coarse fit the full resolution
+    // search uses the usual windows around the previous lane.
+    coarse_hit = false;
+    if (refiner != nullptr)
+    {
+        ScopedTimer timer(coarse_ns);
+        double l_coarse[LANE_MAX_DEGREE];
+        double r_coarse[LANE_MAX_DEGREE];
+        coarse_hit = searchCoarse(mask, l_coarse, r_coarse);
+        if (coarse_hit)
         {
-            if (found_left && found_right) 
-            {
-                break;
-            } 
+            lanePositions(l_coarse, r_coarse, degree,
+                          &search_rows[0], search_rows.size(), &search_left[0], &search_right[0]);
+            stats.left.threshold = stats.right.threshold = CORRIDOR * pyramid_scale;
+            stats.left.col_step = stats.right.col_step = 1;
+        }
+    }
 
-            if (!found_left && dst.at<uchar>(i, left+j) == 255) 
-            {
-                lx.push_back(left+j);
-                ly.push_back(i);
-                found_left = true;
-            }
-            
-            if (!found_left && dst.at<uchar>(i, left-j) == 255) 
-            {
-                lx.push_back(left-j);
-                ly.push_back(i);
-                found_left = true;
-            }
+    lfit->add(0, search_left[0]);
+    rfit->add(0, search_right[0]);
 
-            if (!found_right && dst.at<uchar>(i, right-j) == 255) 
+    // Searches row i for one lane line outwards from the predicted column,
+    // first towards `inner` (+1 for the left line, -1 for the right one).
+    // probe(i, j) tells whether pixel (i, j) of the thresholded birdseye image
+    // is set. Returns the column of the first hit or -1.
+    auto probing = [](auto probe)
+    {
+        return [probe](int i, int center, int inner, const Window &window, int &reads)
+        {
+            for (int j = 0; j <= window.threshold; j+=window.col_step)
             {
-                rx.push_back(right-j);
-                ry.push_back(i);
-                found_right = true;
+                reads++;
+                if (probe(i, center + inner * j)) return center + inner * j;
+                if (j == 0) continue;
+                reads++;
+                if (probe(i, center - inner * j)) return center - inner * j;
             }
-            
-            if (!found_right && dst.at<uchar>(i, right+j) == 255) 
+            return -1;
+        };
+    };
+
+    // Loop through frame rows at row_step for one lane line (side 0 left,
+    // 1 right). Row i is fitter slot. find(i, center, inner, window, reads)
+    // returns the column of the lane pixel for a row. With a task pool the
+    // line is also fitted here, so both lines are searched and fitted
+    // concurrently.
+    int reads[2] = {0, 0};
+    auto scan = [&](auto find, int side)
+    {
+        const std::vector<double> &predicted = side ? search_right : search_left;
+        const Window &window = side ? stats.right : stats.left;
+        LaneFitter *fit = side ? rfit : lfit;
+        std::vector<int> &slots = side ? hit_slots_right : hit_slots_left;
+        std::vector<double> &xs = side ? hit_right : hit_left;
+        int rows = 0;
+        for (int i = height-1, slot = 1, row = 0; i >= 0; i-=rstep, slot+=factor, row++)
+        {
+            if (row % window.row_skip != 0) continue;
+            rows++;
+            int x = find(i, (int)predicted[slot], side ? -1 : 1, window, reads[side]);
+            if (x >= 0)
             {
-                rx.push_back(right+j);
-                ry.push_back(i);
-                found_right = true;
+                fit->add(slot, x);
+                slots.push_back(slot);
+                xs.push_back(x);
             }
         }
-         
+        (side ? stats.rows_right : stats.rows_left) = rows;
+        if (pool != nullptr)
+        {
+            solved[side] = fit->isReady() && fit->solve(fits[side]);
+        }
+    };
+    auto both = [&](auto find)
+    {
+        if (pool != nullptr)
+        {
+            pool->parallelFor(2, [&](int side) { scan(find, side); });
+        }
+        else
+        {
+            scan(find, 0);
+            scan(find, 1);
+        }
+    };
+
+    {
+        ScopedTimer timer(search_ns);
+        if (sampler != nullptr)
+        {
+            // Sparse: classify only the search window pixels, straight from the frame
+            sampler->setFrame(frame);
+            both(probing([this](int i, int j) { return sampler->probe(i, j); }));
+        }
+        else if (refiner != nullptr)
+        {
+            refiner->setFrame(frame);
+            both(probing([this](int i, int j) { return refiner->probe(i, j); }));
+        }
+        else if (use_bitmask)
+        {
+            // Nearest set bit on either side, whatever the column stride
+            both([&packed](int i, int center, int inner, const Window &window, int &reads) {
+                reads += 2 * window.threshold + 1;
+                return packed.nearest(i, center, window.threshold, inner);
+            });
+        }
+        else
+        {
+            const int cols = mask.cols;
+            both(probing([&mask, cols](int i, int j) { return j >= 0 && j < cols && mask.at<uchar>(i, j) == 255; }));
+        }
     }
+    stats.reads = reads[0] + reads[1];
+
+    // Slot 0 holds the predicted bottom point, not a hit
+    search_hits.left = lfit->getCount() - 1;
+    search_hits.right = rfit->getCount() - 1;
+}
 
-    if (lx.size() > 3 && rx.size() > 3)
+/**
+ * Fits the hits left by searchLines() and updates the lane, the confidence
+ * of each line and, in adaptive mode, the next windows
+ * @param solve fit lfit and rfit here; otherwise solved and fits already hold the fits
+ * @param solved whether each line was fitted
+ * @param fits fit of each line
+ */
+void Detector::fitLines(bool solve, bool *solved, double (*fits)[LANE_MAX_DEGREE])
+{
+    SearchStats &stats = search_stats;
+
+    frames_counter.add();
+    if (Metrics::enabled())
     {
-        std::vector<double> l_new(degree, 0.0);
-        std::vector<double> r_new(degree, 0.0);
-        polynomialfit(lx.size(), degree, &ly[0], &lx[0], &l_new[0]);
-        polynomialfit(rx.size(), degree, &ry[0], &rx[0], &r_new[0]);
-        
+        hits_left.record(search_hits.left);
+        hits_right.record(search_hits.right);
+        pixel_reads.record(stats.reads);
+        window_left.record(stats.left.threshold);
+        window_right.record(stats.right.threshold);
+    }
+
+    ScopedTimer timer(fit_ns);
+
+    if (solve && lfit->isReady() && rfit->isReady())
+    {
+        solved[0] = lfit->solve(fits[0]);
+        solved[1] = solved[0] && rfit->solve(fits[1]);
+    }
+
+    stats.rms_left = stats.rms_right = -1;
+    stats.confidence_left = stats.confidence_right = 0;
+    if (solved[0] && solved[1])
+    {
+        const double *l_new = fits[0];
+        const double *r_new = fits[1];
         lane->update(l_new, r_new);
-        lx.clear();
-        rx.clear();
-        ly.clear();
-        ry.clear();
-    }    
+
+        // Confidence: share of probed rows with a hit, discounted by how
+        // far the hits scatter around the fit relative to the base window
+        stats.rms_left = residual(l_new, hit_slots_left, hit_left);
+        stats.rms_right = residual(r_new, hit_slots_right, hit_right);
+        stats.confidence_left = (double)search_hits.left / std::max(1, stats.rows_left)
+                * std::max(0.0, 1 - stats.rms_left / threshold);
+        stats.confidence_right = (double)search_hits.right / std::max(1, stats.rows_right)
+                * std::max(0.0, 1 - stats.rms_right / threshold);
+    }
+    else
+    {
+        fits_skipped.add();
+    }
+    stats.sigma_left = lfit->uncertainty(frame_height);
+    stats.sigma_right = rfit->uncertainty(frame_height);
+    lfit->reset();
+    rfit->reset();
+
+    if (adaptive)
+    {
+        next_left = nextWindow(stats.confidence_left);
+        next_right = nextWindow(stats.confidence_right);
+    }
 }
 
 /**
- * Draws lane on an image
- * @param img Image on which to draw lane
- * @param lane Lane to draw
- * @param m perspective transform matrix for lane
+ * Searches and fits both lane lines in the coarse mask of pyramid mode, in
+ * windows of detector.threshold full resolution pixels around the current
+ * lane, every detector.row_step full resolution rows.
+ * @param mask thresholded birdseye image downscaled by 2^detector.pyramid
+ * @param l_new receives the left fit, in full resolution coordinates
+ * @param r_new receives the right fit, in full resolution coordinates
+ * @return false if either line has too few hits
  */
-const cv::Mat& Detector::drawLane() const
+bool Detector::searchCoarse(const cv::Mat &mask, double *l_new, double *r_new)
 {
-    static cv::Mat img;
-    img = get_frame();  
-    Mat blank(img.size(), img.type(), Scalar(0, 0, 0));
-    auto lparams = lane->getLParams();
-    auto rparams = lane->getRParams();
-    for (int i = 0; i < img.rows; i++)
-    {
-        circle(blank, Point((int)polynomial(lparams, i), i), 3, Scalar(150, 0, 0), 3);
-        circle(blank, Point((int)polynomial(rparams, i), i), 3, Scalar(150, 0, 0), 3);
+    const int degree = lane->getDegree();
+    const double s = pyramid_scale;
+    const int window = std::max(1, threshold / pyramid_scale);
+
+    // x_coarse(y) = x(s * y) / s, so coefficient k scales by s^(k-1), and back
+    double l_coarse[LANE_MAX_DEGREE];
+    double r_coarse[LANE_MAX_DEGREE];
+    double p = 1 / s;
+    for (int k = 0; k < degree; k++, p *= s)
+    {
+        l_coarse[k] = lane->getLParams()[k] * p;
+        r_coarse[k] = lane->getRParams()[k] * p;
     }
-    warpPerspective(blank, blank, matrix_transform_fiperson, Size(img.cols, img.rows));
-    for (int i = 0; i < img.rows; i+=2)
+
+    auto probe = [&mask](int i, int j) { return j >= 0 && j < mask.cols && mask.at<uchar>(i, j) == 255; };
+    auto find = [&](int i, int center, int inner)
     {
-        for (int j = 0; j < img.cols; j+=2)
+        for (int j = 0; j <= window; j++)
         {
-            if (blank.at<Vec3b>(i, j)[0] == 150)
-                circle(img, Point(j, i), 1, Scalar(150, 0, 0), 1);
+            if (probe(i, center + inner * j)) return center + inner * j;
+            if (j > 0 && probe(i, center - inner * j)) return center - inner * j;
         }
+        return -1;
+    };
+
+    coarse_lfit->add(0, polynomial(l_coarse, degree, mask.rows));
+    coarse_rfit->add(0, polynomial(r_coarse, degree, mask.rows));
+    for (int i = mask.rows-1, slot = 1; i >= 0; i-=coarse_step, slot++)
+    {
+        int x = find(i, (int)polynomial(l_coarse, degree, i), 1);
+        if (x >= 0) coarse_lfit->add(slot, x);
+        x = find(i, (int)polynomial(r_coarse, degree, i), -1);
+        if (x >= 0) coarse_rfit->add(slot, x);
     }
 
-    return img;
+    bool found = coarse_lfit->isReady() && coarse_rfit->isReady() &&
+                 coarse_lfit->solve(l_coarse) && coarse_rfit->solve(r_coarse);
+    coarse_lfit->reset();
+    coarse_rfit->reset();
+    if (!found) return false;
+
+    p = s;
+    for (int k = 0; k < degree; k++, p /= s)
+    {
+        l_new[k] = l_coarse[k] * p;
+        r_new[k] = r_coarse[k] * p;
+    }
+    return true;
+}
+
+/**
+ * @param params coefficients fitted to the hits
+ * @param slots fitter slots of the hits
+ * @param xs columns of the hits
+ * @return root mean square distance of the hits from the fitted line, px
+ */
+double Detector::residual(const double *params, const std::vector<int> &slots, const std::vector<double> &xs) const
+{
+    if (slots.empty()) return 0;
+    double sum = 0;
+    for (size_t k = 0; k < slots.size(); k++)
+    {
+        double d = xs[k] - polynomial(params, lane->getDegree(), search_rows[slots[k]]);
+        sum += d * d;
+    }
+    return std::sqrt(sum / slots.size());
+}
+
+/**
+ * Sizes the search window of a lane line for the next frame
+ * (detector.adaptive). A confidently tracked line is searched in a narrower
+ * window on every other row; an unsure or lost one in a window up to twice
+ * detector.threshold wide with a finer column stride.
+ * @param confidence confidence of the line in the frame just searched
+ */
+Detector::Window Detector::nextWindow(double confidence) const
+{
+    Window window;
+    window.threshold = std::max(1, (int)std::lround(threshold * (2 - 1.5 * confidence)));
+    window.row_skip = confidence >= CONFIDENT ? 2 : 1;
+    window.col_step = confidence < UNSURE ? std::max(1, col_step / 2) : col_step;
+    return window;
+}
+
+/**
+ * Draws the lane on a copy of the frame it was detected in. Each lane line is
+ * evaluated at OVERLAY_ROWS birdseye rows, the points are projected into the
+ * camera image and joined with a polyline. Points that fall outside the
+ * birdseye image would not be visible in the camera image and break the line.
+ * @return frame with the lane drawn on it, valid until the next call
+ */
+const cv::Mat& Detector::drawLane() const
+{
+    ScopedTimer timer(draw_ns);
+    frame.copyTo(overlay);
+
+    lanePositions(current->getLParams(), current->getRParams(), current->getDegree(),
+                  &overlay_rows[0], overlay_rows.size(), &overlay_left[0], &overlay_right[0]);
+
+    for (const std::vector<double> *xs : {&overlay_left, &overlay_right})
+    {
+        overlay_birdseye.clear();
+        for (size_t i = 0; i < overlay_rows.size(); i++)
+        {
+            overlay_birdseye.push_back(Point2f((*xs)[i], overlay_rows[i]));
+        }
+        perspectiveTransform(overlay_birdseye, overlay_camera, matrix_transform_fiperson);
+
+        overlay_line.clear();
+        for (size_t i = 0; i <= overlay_rows.size(); i++)
+        {
+            bool visible = i < overlay_rows.size() && (*xs)[i] >= 0 && (*xs)[i] < frame_width;
+            if (visible)
+            {
+                overlay_line.push_back(Point(overlay_camera[i].x, overlay_camera[i].y));
+            }
+            else if (!overlay_line.empty())
+            {
+                polylines(overlay, overlay_line, false, Scalar(150, 0, 0), 3);
+                overlay_line.clear();
+            }
+        }
+    }
+
+    return overlay;
 }
 
 /**
@@ -245,16 +992,29 @@ Mat Detector::getTransformMatrix(int height, int width, double angle, double per
     return m;
 }
 
-double Detector::getTurningRadius()
+const Lane& Detector::getLane() const { return *lane; }
+
+/**
+ * Gets how many search rows hit each lane line in the frame of the current lane
+ */
+Detector::Hits Detector::getHits() const { return current_hits; }
+
+/**
+ * Gets the windows, pixel reads and confidence of the search of the frame of
+ * the current lane
+ */
+Detector::SearchStats Detector::getSearchStats() const { return current_stats; }
+
+double Detector::getTurningRadius() const
 {
-    static const double x1 = (double)frame_width / 2;
-    static const double y1 = (double)frame_height;
-    static const double y2 = (double)frame_height * 0.25;
-    static const double y3 = (double)frame_height * 0.5;
+    const double x1 = (double)frame_width / 2;
+    const double y1 = (double)frame_height;
+    const double y2 = (double)frame_height * 0.25;
+    const double y3 = (double)frame_height * 0.5;
 
-    auto params = lane->getParams();
-    double x2 = polynomial(params, y1);
-    double x3 = polynomial(params, y2);
+    const double *params = current->getParams();
+    double x2 = polynomial(params, current->getDegree(), y1);
+    double x3 = polynomial(params, current->getDegree(), y2);
 
     double A = sqrt(pow(x2 - x3, 2) + pow(y2 - y3, 2));
     double B = sqrt(pow(x3 - x1, 2) + pow(y3 - y1, 2));
@@ -267,38 +1027,3 @@ double Detector::getTurningRadius()
     return d > 0 ? radius : -radius;
 }
 
-
-//-----NON CLASS METHODS-----//
-
-/**
- * Thresholds the image. Uses GPU acceleration
- * Process:
- *   1. Convert image to grayscale
- *   2. Blur the image to remove noise (gaussian)
- *   3. threshold image (binary)
- * @param src image to threshold (GpuMat)
- * @param dst destination for thresholded image (GpuMat)
- */
-void thresh(const cv::Mat &src, cv::Mat &dst, int threshold)
-{
-    cv::cvtColor(src, dst, CV_BGR2GRAY);
-    cv::GaussianBlur(dst, dst, Size( 7, 7 ), 1.5, 1.5 );
-    cv::threshold(dst, dst, threshold, 255, THRESH_BINARY);
-}
-
-/**
- * Evaluates a polynomial expression
- * @param params Array of polynomial coefficients
- * @param degree Degree of polynomial (size of params)
- * @param x Polynomial input
- * @return Evaluated expression.
- */
-double polynomial(std::vector<double> params, double x)
-{
-    double val = 0;
-    for (uint i = 0; i < params.size(); i++)
-    {
-        val += params[i] * pow(x, i);
-    }
-    return val;
-}	
\ No newline at end of file
@@ -6,16 +6,76 @@ using namespace std;
 #include "opencv2/opencv.hpp"
 #include "lane.h"
 #include "helpers.h"
+#include "preprocess.h"
+#include "sparse.h"
+#include "bitmask.h"
+#include "fixedfit.h"
+#include "rlsfit.h"
+#include "scheduler.h"
+#include "metrics.h"
+#include "recorder.h"
+#include "taskpool.h"
 
 #include <string>
 #include <cmath>
 #include <vector>
 #include <functional>
 #include <thread>
+#include <atomic>
+#include <cstdint>
 
 class Detector
 {
+public:
+    struct StageStats
+    {
+        uint64_t frames;  // frames that left the stage
+        double busy_ms;   // time spent working
+        double stall_ms;  // time spent waiting on an empty input or full output queue
+        double occupancy; // mean length of the input queue when the stage took a frame
+    };
+
+    enum Stage { STAGE_PREPROCESS, STAGE_SEARCH, STAGE_CALLBACK, STAGE_COUNT };
+
+    struct Hits
+    {
+        int left;  // search rows with a hit on the left lane line
+        int right; // search rows with a hit on the right lane line
+    };
+
+    // Where one lane line is searched in a frame
+    struct Window
+    {
+        int threshold; // columns searched on each side of the predicted line
+        int row_skip;  // the line is probed on every row_skip-th search row
+        int col_step;  // stride between probed columns
+    };
+
+    struct SearchStats
+    {
+        Window left;
+        Window right;
+        int rows_left;           // search rows the left line was probed on
+        int rows_right;          // search rows the right line was probed on
+        int reads;               // pixels probed for both lines (bitmask: pixels in the windows)
+        double rms_left;         // residual of the left fit to its hits, px
+        double rms_right;        // residual of the right fit to its hits, px
+        double confidence_left;  // 0 (lost) to 1 (solid), picks the next left window
+        double confidence_right; // 0 (lost) to 1 (solid), picks the next right window
+        double sigma_left;       // lane.estimator = "rls": standard deviation of the left line at the bottom row, px; -1 otherwise
+        double sigma_right;      // same for the right line
+    };
+
 private:
+    struct StageCounters
+    {
+        std::atomic<uint64_t> frames;
+        std::atomic<uint64_t> busy_ns;
+        std::atomic<uint64_t> stall_ns;
+        std::atomic<uint64_t> occupancy;
+        std::atomic<uint64_t> samples;
+    };
+
     int threshold;
     int row_step;
     int col_step;
@@ -24,7 +84,6 @@ private:
     int img_threshold;
     cv::Mat matrix_transform_birdseye;
     cv::Mat matrix_transform_fiperson;
-    cv::VideoWriter out;
    
     double vehicle_length;
     double vehicle_width;
@@ -36,26 +95,109 @@ private:
 
     cv::VideoCapture cap;
     Lane *lane;
+    const Lane *current;                  // lane matching `frame`, read by drawLane() and getTurningRadius()
+    Hits search_hits = {0, 0};            // hits of the frame search() saw last
+    Hits current_hits = {0, 0};           // hits of the frame `current` was fitted to
+    SearchStats search_stats = {};        // window and reads of the frame search() saw last
+    SearchStats current_stats = {};       // window and reads of the frame `current` was fitted to
+    bool adaptive = false;                // detector.adaptive: size windows from the last frame's confidence
+    Window next_left;                     // window for the next left search
+    Window next_right;                    // window for the next right search
+    Preprocessor *preprocessor = nullptr; // remap lookup table, used when detector.preprocess = "remap"
+    SparseSampler *sampler = nullptr;     // per-pixel classifier, used when detector.sparse = true
+    bool use_bitmask = false;             // detector.bitmask: search a bit-packed copy of the mask
+    int pyramid = 0;                      // detector.pyramid: levels the coarse mask is downscaled by
+    int pyramid_scale = 1;                // 2^pyramid
+    cv::Mat matrix_transform_coarse;      // camera -> birdseye at the coarse level
+    SparseSampler *refiner = nullptr;     // full resolution probes in the corridors around the coarse fit
+    LaneFitter *coarse_lfit = nullptr;    // left hits at the coarse level
+    LaneFitter *coarse_rfit = nullptr;    // right hits at the coarse level
+    int coarse_step = 1;                  // row_step at the coarse level
+    TaskPool *pool = nullptr;             // detector.threads > 1: stripes preprocessing, searches lines concurrently (main() turns OpenCV's threads off)
+    cv::Mat matrix_inverse_birdseye;      // birdseye -> camera, for warping one stripe at a time
+    int stripe_rows = 0;                  // rows per preprocessing stripe
+    bool coarse_hit = false;              // pyramid: the last search ran around its frame's coarse fit
+    LaneFitter *lfit = nullptr;           // accumulates left lane hits
+    LaneFitter *rfit = nullptr;           // accumulates right lane hits
+
+    std::vector<double> search_rows;      // rows searched by update(), in fitter slot order
+    std::vector<double> search_left;      // predicted left lane column per searched row
+    std::vector<double> search_right;     // predicted right lane column per searched row
+    std::vector<int> hit_slots_left;      // fitter slots of this frame's left hits
+    std::vector<double> hit_left;         // columns of this frame's left hits
+    std::vector<int> hit_slots_right;
+    std::vector<double> hit_right;
+    std::vector<double> overlay_rows;     // birdseye rows drawn by drawLane()
+    mutable std::vector<double> overlay_left;
+    mutable std::vector<double> overlay_right;
+    mutable std::vector<cv::Point2f> overlay_birdseye; // one lane line in birdseye coordinates
+    mutable std::vector<cv::Point2f> overlay_camera;   // the same points in the camera image
+    mutable std::vector<cv::Point> overlay_line;       // visible run of points being drawn
+    cv::Mat frame;           // most recent frame passed to update(), reused by drawLane()
+    cv::Mat th;              // thresholded frame
+    cv::Mat dst;             // thresholded birdseye image
+    BitMask bits;            // dst packed to one bit per pixel, in bitmask mode
+    mutable cv::Mat overlay; // frame with the lane drawn on it
 
     std::function<cv::Mat()> get_frame;
     double freq_hz;
-    
-    cv::Mat getTransformMatrix(int height, int width, double angle, double perc_low, double perc_high, bool undo=false);
+    bool pipelined = false;               // detector.pipeline: overlap preprocess, search and callback
+    RateScheduler::Policy overrun_policy = RateScheduler::SKIP; // detector.overrun
+    RateScheduler *scheduler = nullptr;   // paces the detection loop once started
+    Recorder *recorder = nullptr;         // record section: writes frames on its own thread
+    StageCounters stage_counters[STAGE_COUNT];
+
+    // Instruments shared by every Detector in the process (see Metrics)
+    Histogram &update_ns;
+    Histogram &preprocess_ns;
+    Histogram &search_ns;
+    Histogram &coarse_ns;
+    Histogram &fit_ns;
+    Histogram &draw_ns;
+    Histogram &hits_left;
+    Histogram &hits_right;
+    Histogram &pixel_reads;
+    Histogram &window_left;
+    Histogram &window_right;
+    Counter &frames_counter;
+    Counter &fits_skipped;
 
     std::thread *detect_thread = nullptr;
 
-    void detect(double freq_hz, std::function<void(const Lane &lane)> callback);
+    void detect(std::function<void(const Lane &lane)> callback);
+    void detectPipelined(std::function<void(const Lane &lane)> callback);
     void update(const cv::Mat &img);
+    void preprocess(const cv::Mat &frame, cv::Mat &gray, cv::Mat &mask, BitMask &packed);
+    void preprocessStriped(const cv::Mat &frame, cv::Mat &gray, cv::Mat &mask);
+    void search(const cv::Mat &frame, const cv::Mat &mask, const BitMask &packed);
+    void searchLines(const cv::Mat &frame, const cv::Mat &mask, const BitMask &packed,
+                     bool *solved, double (*fits)[LANE_MAX_DEGREE]);
+    void fitLines(bool solve, bool *solved, double (*fits)[LANE_MAX_DEGREE]);
+    void record(const cv::Mat &mask);
+    bool searchCoarse(const cv::Mat &mask, double *l_new, double *r_new);
+    double residual(const double *params, const std::vector<int> &slots, const std::vector<double> &xs) const;
+    Window nextWindow(double confidence) const;
 
 public:
-    Detector(string config_path, std::function<cv::Mat()> get_frame);
+    Detector(string config_path, std::function<cv::Mat()> get_frame, bool worker = false);
     virtual ~Detector();
     const cv::Mat&  drawLane() const;
 
     void start(double freq_hz, std::function<void(const Lane &lane)> callback);
     void join();
+    bool step();
+    void prepare(const cv::Mat &frame);
+    void commit(const Detector &prepared);
+
+    const Lane& getLane() const;
+    Hits getHits() const;
+    SearchStats getSearchStats() const;
+    double getTurningRadius() const;
+    StageStats getStageStats(Stage stage) const;
+    RateScheduler::Stats getSchedulerStats() const;
+    Recorder::Stats getRecorderStats(Recorder::Stream stream) const;
 
-    double getTurningRadius();
+    static cv::Mat getTransformMatrix(int height, int width, double angle, double perc_low, double perc_high, bool undo=false);
 
 };
 
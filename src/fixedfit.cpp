@@ -0,0 +1,64 @@
+#include "fixedfit.h"
+#include "polifitgsl.h"
+
+/**
+ * Fallback for degrees without a FixedFitter instantiation. Buffers the hits
+ * and hands them to polynomialfit().
+ */
+class GslFitter : public LaneFitter
+{
+private:
+    int degree;
+    int height;
+    int row_step;
+    std::vector<double> ys;
+    std::vector<double> xs;
+
+public:
+    GslFitter(int degree, int height, int row_step)
+        : degree(degree), height(height), row_step(row_step) {}
+
+    void reset() override
+    {
+        ys.clear();
+        xs.clear();
+    }
+
+    void add(int slot, double x) override
+    {
+        add(slot == 0 ? (double)height : (double)(height - 1 - (slot - 1) * row_step), x);
+    }
+
+    void add(double y, double x) override
+    {
+        ys.push_back(y);
+        xs.push_back(x);
+    }
+
+    int getCount() const override { return ys.size(); }
+
+    bool solve(double *store) const override
+    {
+        if ((int)ys.size() < degree) return false;
+        return polynomialfit(ys.size(), degree, &ys[0], &xs[0], store);
+    }
+};
+
+/**
+ * Creates the fitter for a lane polynomial.
+ * @param degree number of coefficients (lane.n); 2 to 5 use FixedFitter
+ * @param height height of the birdseye image
+ * @param row_step stride between scanned rows
+ * @return new fitter, owned by the caller
+ */
+LaneFitter *LaneFitter::create(int degree, int height, int row_step)
+{
+    switch (degree)
+    {
+        case 2: return new FixedFitter<2>(height, row_step);
+        case 3: return new FixedFitter<3>(height, row_step);
+        case 4: return new FixedFitter<4>(height, row_step);
+        case 5: return new FixedFitter<5>(height, row_step);
+        default: return new GslFitter(degree, height, row_step);
+    }
+}
@@ -0,0 +1,203 @@
+/**
+ * Provides allocation-free least-squares polynomial fitting for lane hits.
+ */
+
+#ifndef FIXEDFIT_H
+#define FIXEDFIT_H
+
+#include <cmath>
+#include <vector>
+
+/**
+ * Accumulates (y, x) hits and fits x = c[0] + c[1]*y + ... + c[degree-1]*y^(degree-1).
+ *
+ * Hits are usually taken on the fixed grid of rows scanned by Detector, which
+ * are known up front: slot 0 is y = height and slot k > 0 is
+ * y = height - 1 - (k - 1) * row_step. Hits anywhere else can be added by
+ * value. Rows without a hit simply contribute nothing.
+ */
+class LaneFitter
+{
+public:
+    virtual ~LaneFitter() {}
+
+    virtual void reset() = 0;
+    virtual void add(int slot, double x) = 0;
+    virtual void add(double y, double x) = 0;
+    virtual int getCount() const = 0;
+    virtual bool solve(double *store) const = 0;
+
+    /**
+     * @return true if the hits are enough to update the lane with solve():
+     *         more than three this frame
+     */
+    virtual bool isReady() const { return getCount() > 3; }
+
+    /**
+     * @param y row
+     * @return standard deviation of the fitted column at row y, px, or -1
+     *         if the fitter does not estimate it
+     */
+    virtual double uncertainty(double y) const { (void)y; return -1; }
+
+    static LaneFitter *create(int degree, int height, int row_step);
+    static LaneFitter *createRecursive(int degree, int height, int row_step, double forgetting);
+
+protected:
+    /**
+     * Converts coefficients of powers of t = (y - center) / scale to
+     * coefficients of powers of y
+     * @param a n coefficients of powers of t
+     * @param n number of coefficients
+     * @param store array of size n receiving the coefficients of powers of y
+     */
+    static void unscale(const double *a, int n, double center, double scale, double *store)
+    {
+        // sum a_k ((y - c) / s)^k  ->  sum b_j y^j
+        for (int j = 0; j < n; j++) store[j] = 0;
+        double inv = 1 / scale;
+        double sk = 1; // s^-k
+        for (int k = 0; k < n; k++, sk *= inv)
+        {
+            double binom = 1;    // C(k, j)
+            double shift = 1;    // (-c)^(k-j), built from j = k downwards
+            for (int j = k; j >= 0; j--)
+            {
+                store[j] += a[k] * sk * binom * shift;
+                binom = binom * j / (k - j + 1);
+                shift *= -center;
+            }
+        }
+    }
+};
+
+/**
+ * Fitter with a compile-time number of coefficients.
+ *
+ * Solves the normal equations in the scaled variable t = (y - h/2) / (h/2),
+ * which keeps them well conditioned, and converts the result back to powers
+ * of y. Powers of t for every grid row are tabulated in the constructor, so
+ * adding a hit is a handful of multiply-adds and nothing touches the heap
+ * after construction.
+ */
+template <int N>
+class FixedFitter : public LaneFitter
+{
+private:
+    static const int M = 2 * N - 1; // number of distinct entries in the normal matrix
+
+    double center;
+    double scale;
+    std::vector<double> powers; // M powers of t per grid slot
+
+    double moments[M]; // sum of t^k over all hits
+    double rhs[N];     // sum of x * t^k over all hits
+    int count;
+
+    void accumulate(const double *p, double x)
+    {
+        for (int k = 0; k < M; k++) moments[k] += p[k];
+        for (int k = 0; k < N; k++) rhs[k] += x * p[k];
+        count++;
+    }
+
+public:
+    /**
+     * @param height height of the birdseye image
+     * @param row_step stride between scanned rows
+     */
+    FixedFitter(int height, int row_step)
+        : center(height / 2.0), scale(height / 2.0)
+    {
+        int slots = row_step > 0 ? (height - 1) / row_step + 2 : 1;
+        powers.resize(slots * M);
+        for (int s = 0; s < slots; s++)
+        {
+            double y = s == 0 ? height : height - 1 - (s - 1) * row_step;
+            double t = (y - center) / scale;
+            double p = 1;
+            for (int k = 0; k < M; k++, p *= t) powers[s * M + k] = p;
+        }
+        reset();
+    }
+
+    void reset() override
+    {
+        for (int k = 0; k < M; k++) moments[k] = 0;
+        for (int k = 0; k < N; k++) rhs[k] = 0;
+        count = 0;
+    }
+
+    /**
+     * Adds a hit on a grid row
+     * @param slot grid slot of the row (see LaneFitter)
+     * @param x column of the hit
+     */
+    void add(int slot, double x) override
+    {
+        accumulate(&powers[slot * M], x);
+    }
+
+    /**
+     * Adds a hit on an arbitrary row
+     * @param y row of the hit
+     * @param x column of the hit
+     */
+    void add(double y, double x) override
+    {
+        double p[M];
+        double t = (y - center) / scale;
+        p[0] = 1;
+        for (int k = 1; k < M; k++) p[k] = p[k - 1] * t;
+        accumulate(p, x);
+    }
+
+    int getCount() const override { return count; }
+
+    /**
+     * Solves for the coefficients of the hits added since the last reset.
+     * @param store array of size N receiving the coefficients of powers of y
+     * @return false if the hits do not determine the polynomial
+     */
+    bool solve(double *store) const override
+    {
+        // Cholesky factorisation of the Hankel normal matrix A[j][k] = moments[j + k]
+        double L[N][N];
+        for (int j = 0; j < N; j++)
+        {
+            for (int k = 0; k <= j; k++)
+            {
+                double sum = moments[j + k];
+                for (int i = 0; i < k; i++) sum -= L[j][i] * L[k][i];
+                if (j == k)
+                {
+                    if (sum <= 1e-12 * moments[0]) return false;
+                    L[j][j] = std::sqrt(sum);
+                }
+                else
+                {
+                    L[j][k] = sum / L[k][k];
+                }
+            }
+        }
+
+        double a[N];
+        for (int j = 0; j < N; j++)
+        {
+            double sum = rhs[j];
+            for (int i = 0; i < j; i++) sum -= L[j][i] * a[i];
+            a[j] = sum / L[j][j];
+        }
+        for (int j = N - 1; j >= 0; j--)
+        {
+            double sum = a[j];
+            for (int i = j + 1; i < N; i++) sum -= L[i][j] * a[i];
+            a[j] = sum / L[j][j];
+        }
+
+        unscale(a, N, center, scale, store);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * gen_road.cpp
+ * Writes synthetic road frames rendered by RoadGenerator to a video or an
+ * image sequence and prints the ground truth lane coefficients as CSV.
+ *
+ * Usage: gen_road <config file> <output> [frames] [name=value ...]
+ *   output: a video file (.avi, .mp4, .mkv) or a printf pattern such as road_%04d.png
+ *   names:  width, height, center, lane_width, heading, curvature,
+ *           line_width, noise, occlusion, seed (see RoadGenerator::Params)
+ *
+ * Example: gen_road test/detect.cfg road.avi 300 width=3840 height=2160 curvature=0.1
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "opencv2/opencv.hpp"
+
+#include "roadgen.h"
+
+using namespace cv;
+
+#define FPS 30
+
+bool is_video(const string &path)
+{
+    for (const char *ext : {".avi", ".mp4", ".mkv"})
+    {
+        size_t n = string(ext).size();
+        if (path.size() >= n && path.compare(path.size() - n, n, ext) == 0) return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cout << "Usage: " << argv[0] << " <config file> <output> [frames] [name=value ...]" << endl;
+        return 0;
+    }
+    string config_path(argv[1]);
+    string output(argv[2]);
+    int frames = argc > 3 ? atoi(argv[3]) : 100;
+
+    RoadGenerator::Params params;
+    for (int i = 4; i < argc; i++)
+    {
+        if (!RoadGenerator::parse(params, argv[i]))
+        {
+            cerr << "Unknown setting " << argv[i] << endl;
+            return 1;
+        }
+    }
+    RoadGenerator generator(config_path, params);
+
+    VideoWriter writer;
+    if (is_video(output))
+    {
+        writer.open(output, CV_FOURCC('M', 'J', 'P', 'G'), FPS, Size(params.width, params.height));
+        if (!writer.isOpened())
+        {
+            cerr << "Could not open " << output << endl;
+            return 1;
+        }
+    }
+
+    Mat frame;
+    double render_s = 0;
+    std::vector<char> name(output.size() + 32);
+    for (int i = 0; i < frames; i++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        generator.render(i, frame);
+        render_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        if (writer.isOpened())
+        {
+            writer.write(frame);
+        }
+        else
+        {
+            snprintf(name.data(), name.size(), output.c_str(), i);
+            imwrite(name.data(), frame);
+        }
+    }
+
+    cout << "side";
+    for (int i = 0; i < generator.getDegree(); i++) cout << ",c" << i;
+    cout << endl;
+    cout << "left";
+    for (int i = 0; i < generator.getDegree(); i++) cout << "," << generator.getLeft()[i];
+    cout << endl;
+    cout << "right";
+    for (int i = 0; i < generator.getDegree(); i++) cout << "," << generator.getRight()[i];
+    cout << endl;
+
+    cerr << frames << " frames at " << params.width << "x" << params.height
+         << ", " << frames / render_s << " frames/s rendered" << endl;
+}
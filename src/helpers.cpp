@@ -1,5 +1,7 @@
 #include "helpers.h"
 
+#include <cstdio>
+
 /**
  * Removes the whitespace in a path
  * @param path path string to remove whitespace from
@@ -40,4 +42,28 @@ std::string abs_path(std::string path, std::string relative_to) {
     }
 
     return path;
+}
+
+/**
+ * Folds bytes into a 64 bit FNV-1a hash
+ * @param hash hash to update, FNV_OFFSET to start
+ * @param data bytes to fold in
+ * @param size number of bytes
+ */
+void fnv1a(uint64_t &hash, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+}
+
+/**
+ * Formats a hash for printing
+ * @param hash 64 bit hash
+ * @returns 16 hex digits
+ */
+std::string hash_hex(uint64_t hash) {
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    return hex;
 }
\ No newline at end of file
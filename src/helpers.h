@@ -3,10 +3,19 @@
 
 #include <string>
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#define FNV_OFFSET 14695981039346656037ULL // initial value of a 64 bit FNV-1a hash
+#define FNV_PRIME 1099511628211ULL
 
 std::string rem_whitespace(std::string path);
 
 std::string get_dir(std::string path);
 
 std::string abs_path(std::string path, std::string relative_to);
+
+void fnv1a(uint64_t &hash, const void *data, size_t size);
+
+std::string hash_hex(uint64_t hash);
 #endif
\ No newline at end of file
@@ -17,14 +17,16 @@ Lane::Lane(std::string config_path, std::vector<double> lparams, std::vector<dou
     {
         uint n = lparams.size();
         assert(n == rparams.size());
-        cfg.readFile(config_path.c_str());
-        filter = cfg.lookup("lane.filter");
-        for (uint i = 0; i < lparams.size(); i++)
+        assert(n <= LANE_MAX_DEGREE);
+        degree = n;
+        for (uint i = 0; i < LANE_MAX_DEGREE; i++)
         {
-            this->lparams.push_back(lparams[i]);
-            this->rparams.push_back(rparams[i]);
-            params.push_back((lparams[i] + rparams[i]) / 2);
+            this->lparams[i] = i < n ? lparams[i] : 0;
+            this->rparams[i] = i < n ? rparams[i] : 0;
+            params[i] = (this->lparams[i] + this->rparams[i]) / 2;
         }
+        cfg.readFile(config_path.c_str());
+        filter = cfg.lookup("lane.filter");
         vehicle_length = cfg.lookup("vehicle.length");
         vehicle_width = cfg.lookup("vehicle.width");
     }
@@ -40,11 +42,11 @@ Lane::Lane(std::string config_path, std::vector<double> lparams, std::vector<dou
  * @param l Array of size degree. Defines coefficients for left lane curve.
  * @param r Array of size degree. Defines coefficients for right lane curve.
  */
-void Lane::update(std::vector<double> l, std::vector<double> r)
+void Lane::update(const double *l, const double *r)
 {
     if (params[0] != params[0])
     {
-        for (uint i = 0; i < params.size(); i++)
+        for (int i = 0; i < degree; i++)
         {
             this->lparams[i] = l[i];
             this->rparams[i] = r[i];
@@ -53,7 +55,7 @@ void Lane::update(std::vector<double> l, std::vector<double> r)
     }
     else
     {
-        for (uint i = 0; i < params.size(); i++)
+        for (int i = 0; i < degree; i++)
         {
             double temp = (l[i] + r[i]) / 2;
             
@@ -64,12 +66,18 @@ void Lane::update(std::vector<double> l, std::vector<double> r)
     }
 }
 
-int Lane::getDegree() { return this->params.size(); }
-std::vector<double> Lane::getParams() const { return this->params; }
-std::vector<double> Lane::getLParams() const { return this->lparams; }
-std::vector<double> Lane::getRParams() const { return this->rparams; }
+int Lane::getDegree() const { return this->degree; }
+const double *Lane::getParams() const { return this->params; }
+const double *Lane::getLParams() const { return this->lparams; }
+const double *Lane::getRParams() const { return this->rparams; }
 
 double Lane::getFilter() { return this->filter; }
+
+/**
+ * Overrides lane.filter, e.g. with 0 when the fits are already smoothed
+ * @param filter weight of the old lane, 0 to 1
+ */
+void Lane::setFilter(double filter) { this->filter = filter; }
 double Lane::getCurvature() { return this->params[2]; }
 double Lane::getWidth() { return this->width; }
 
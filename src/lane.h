@@ -5,12 +5,18 @@
 #include <cmath>
 #include <string>
 
+#define LANE_MAX_DEGREE 8 // maximum number of polynomial coefficients per lane
+
 class Lane
 {
 private:
-    std::vector<double> params; //array of size degree. Defines coefficients for left lane curve.
-    std::vector<double> lparams;
-    std::vector<double> rparams;
+    int degree; //number of coefficients in use
+    
+    // Coefficients for the center, left and right lane curves, stored
+    // contiguously so they can be read without copying.
+    double params[LANE_MAX_DEGREE];
+    double lparams[LANE_MAX_DEGREE];
+    double rparams[LANE_MAX_DEGREE];
 
     double filter; //filter for curve to remove jitter. lane = old_lane*filter + new_lane*(1-filter).
     double curvature; //positive curvature is right, negative is left
@@ -22,16 +28,17 @@ private:
 public:
     Lane(std::string config_path, std::vector<double> lparams, std::vector<double> rparams);
     
-    int getDegree();
-    std::vector<double> getParams() const;
-    std::vector<double> getLParams() const;
-    std::vector<double> getRParams() const;
+    int getDegree() const;
+    const double *getParams() const;
+    const double *getLParams() const;
+    const double *getRParams() const;
 
     double getFilter();
+    void setFilter(double filter);
     double getCurvature();
     double getWidth();
     
-    void update(std::vector<double> l, std::vector<double> r);
+    void update(const double *l, const double *r);
     
 };
 
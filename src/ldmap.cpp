@@ -0,0 +1,120 @@
+#include "ldmap.h"
+
+#include <cstring>
+#include <algorithm>
+
+/**
+ * @param chunk largest number of new bytes scanned at once
+ */
+LDMapParser::LDMapParser(size_t chunk)
+    : buffer(std::max(chunk, FRAME_SIZE) + FRAME_SIZE), fill(0), stats{0, 0, 0}
+{
+}
+
+/**
+ * Drops any partially received frame
+ */
+void LDMapParser::reset()
+{
+    fill = 0;
+}
+
+/**
+ * Decodes every complete frame in the bytes received so far
+ * @param data newly received bytes
+ * @param size number of new bytes
+ * @param frames decoded frames are appended here
+ */
+void LDMapParser::parse(const uint8_t *data, size_t size, std::vector<LDMap> &frames)
+{
+    while (size > 0)
+    {
+        size_t n = std::min(size, buffer.size() - fill);
+        memcpy(buffer.data() + fill, data, n);
+        fill += n;
+        data += n;
+        size -= n;
+
+        size_t used = scan(frames);
+        memmove(buffer.data(), buffer.data() + used, fill - used);
+        fill -= used;
+    }
+}
+
+/**
+ * Scans the buffer for frames.
+ * @return number of leading bytes that can be discarded; the rest may be the
+ * start of a frame that is not complete yet (less than FRAME_SIZE bytes)
+ */
+size_t LDMapParser::scan(std::vector<LDMap> &frames)
+{
+    const uint8_t *data = buffer.data();
+    size_t pos = 0;
+    while (pos < fill)
+    {
+        const uint8_t *start = (const uint8_t *)memchr(data + pos, UART_FIRST_BYTE, fill - pos);
+        if (start == nullptr)
+        {
+            stats.skipped += fill - pos;
+            return fill;
+        }
+        size_t i = start - data;
+        stats.skipped += i - pos;
+        pos = i;
+
+        // Reject a wrong header as soon as its bytes are available
+        if ((i + 1 < fill && data[i + 1] != UART_SECOND_BYTE) ||
+            (i + 2 < fill && data[i + 2] != sizeof(LDMap)))
+        {
+            stats.skipped++;
+            pos = i + 1;
+            continue;
+        }
+        if (fill - i < FRAME_SIZE) return i;
+
+        const uint8_t *payload = data + i + 3;
+        uint8_t ch = 0;
+        for (size_t k = 0; k < sizeof(LDMap); k++)
+        {
+            ch += payload[k];
+        }
+        if (ch != payload[sizeof(LDMap)])
+        {
+            stats.checksum_errors++;
+            stats.skipped++;
+            pos = i + 1;
+            continue;
+        }
+
+        frames.emplace_back();
+        memcpy(&frames.back(), payload, sizeof(LDMap));
+        stats.frames++;
+        pos = i + FRAME_SIZE;
+    }
+    return pos;
+}
+
+LDMapParser::Stats LDMapParser::getStats() const
+{
+    return stats;
+}
+
+/**
+ * Encodes a frame the way the MCU sends it
+ * @param out destination of at least FRAME_SIZE bytes
+ * @return number of bytes written
+ */
+size_t LDMapParser::frame(const LDMap &ldmap, uint8_t *out)
+{
+    out[0] = UART_FIRST_BYTE;
+    out[1] = UART_SECOND_BYTE;
+    out[2] = sizeof(LDMap);
+    memcpy(out + 3, &ldmap, sizeof(LDMap));
+    uint8_t ch = 0;
+    for (size_t k = 0; k < sizeof(LDMap); k++)
+    {
+        ch += out[3 + k];
+    }
+    out[3 + sizeof(LDMap)] = ch;
+    return FRAME_SIZE;
+}
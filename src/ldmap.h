@@ -0,0 +1,62 @@
+#ifndef LDMAP_H
+#define LDMAP_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#define UART_FIRST_BYTE  'C'
+#define UART_SECOND_BYTE  'O'
+
+typedef struct _LDMap
+{
+   uint8_t id;
+   uint8_t leaderId;
+   int8_t position_x,position_y,position_z; // decimenter 
+   int8_t speed_x,  speed_y, speed_z;   // cm per second
+   int8_t acceleration_x,acceleration_y,acceleration_z; // cm per second square
+   int16_t orientation;
+   uint16_t members;
+   int16_t distance;
+   uint32_t timestamp;
+} LDMap;
+
+/**
+ * Extracts LDMap frames ('C' 'O' length, payload, checksum) from a byte
+ * stream delivered in arbitrary pieces.
+ *
+ * Each piece is scanned for the start byte with memchr and a candidate frame
+ * is validated with a single pass over its payload, instead of stepping a
+ * state machine per byte. A frame split between two pieces is carried over.
+ * After a corrupt frame the scan resumes right after its start byte, so a
+ * real frame hidden inside garbage is still found.
+ */
+class LDMapParser
+{
+public:
+    static const size_t FRAME_SIZE = 3 + sizeof(LDMap) + 1;
+
+    struct Stats
+    {
+        uint64_t frames;          // valid frames decoded
+        uint64_t checksum_errors; // headers whose checksum did not match
+        uint64_t skipped;         // bytes discarded while looking for a header
+    };
+
+    LDMapParser(size_t chunk = 4096);
+
+    void parse(const uint8_t *data, size_t size, std::vector<LDMap> &frames);
+    void reset();
+    Stats getStats() const;
+
+    static size_t frame(const LDMap &ldmap, uint8_t *out);
+
+private:
+    std::vector<uint8_t> buffer; // carried bytes followed by the current chunk
+    size_t fill;
+    Stats stats;
+
+    size_t scan(std::vector<LDMap> &frames);
+};
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * mcu_emulator.cpp
+ * Runs McuEmulator until interrupted: prints the pseudo-terminal to put in
+ * serial.port, streams LDMap frames and prints every command received.
+ *
+ * Usage: mcu_emulator [ldmap rate in Hz] [corruption probability] [garbage probability]
+ */
+
+using namespace std;
+
+#include <iostream>
+#include <csignal>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include "mcuemulator.h"
+
+std::atomic<bool> interrupted(false);
+
+void on_signal(int)
+{
+    interrupted = true;
+}
+
+int main(int argc, char* argv[])
+{
+    McuEmulator::Params params;
+    if (argc > 1) params.ldmap_hz = atof(argv[1]);
+    if (argc > 2) params.corruption = atof(argv[2]);
+    if (argc > 3) params.garbage = atof(argv[3]);
+
+    McuEmulator mcu(params);
+    if (!mcu.isOpen()) return 1;
+
+    auto begin = McuEmulator::Clock::now();
+    mcu.onCommand([begin](const UARTCommand &command, McuEmulator::Clock::time_point arrival) {
+        double t = std::chrono::duration<double, std::milli>(arrival - begin).count();
+        cout << t << " ms: maxTime " << command.maxTime << ", speed " << command.speed
+             << ", orientation " << command.orientation << ", distance " << command.distance
+             << ", dir " << (int)command.dir << endl;
+    });
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    cout << "Emulating the MCU on " << mcu.getPortName() << " (set serial.port to it)" << endl;
+    mcu.start();
+    while (!interrupted)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    mcu.stop();
+
+    McuEmulator::Stats stats = mcu.getStats();
+    cout << "LDMaps sent: " << stats.ldmaps_sent << " (" << stats.ldmaps_corrupted << " corrupted)"
+         << ", commands received: " << stats.commands_received
+         << ", command errors: " << stats.command_errors << endl;
+}
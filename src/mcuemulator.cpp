@@ -0,0 +1,236 @@
+#include "mcuemulator.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <iostream>
+
+#define POLL_MS 10 // how often blocked threads check for stop()
+
+// 'C' 'O' length, payload, checksum, '\r' '\n'
+#define COMMAND_FRAME_SIZE (3 + sizeof(UARTCommand) + 3)
+
+/**
+ * Opens the PTY pair. The slave side is left for SerialCommunication.
+ * @param params LDMap rate and corruption
+ */
+McuEmulator::McuEmulator(const Params &params)
+    : params(params), master(-1), running(false),
+      ldmaps_sent(0), ldmaps_corrupted(0), commands_received(0), command_errors(0)
+{
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        std::cerr << "Could not create pseudo-terminal" << std::endl;
+        if (master >= 0) close(master);
+        master = -1;
+        return;
+    }
+
+    // Raw bytes in both directions, no echo or line editing
+    struct termios tio;
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    port_name = ptsname(master);
+}
+
+McuEmulator::~McuEmulator()
+{
+    stop();
+    if (master >= 0) close(master);
+}
+
+bool McuEmulator::isOpen() const
+{
+    return master >= 0;
+}
+
+/**
+ * @return path of the slave side, e.g. /dev/pts/3
+ */
+const std::string& McuEmulator::getPortName() const
+{
+    return port_name;
+}
+
+/**
+ * Sets the function called with every decoded command and its arrival time.
+ * Runs on the reader thread; set before start().
+ */
+void McuEmulator::onCommand(std::function<void(const UARTCommand&, Clock::time_point)> callback)
+{
+    command_callback = callback;
+}
+
+void McuEmulator::start()
+{
+    if (!isOpen() || running.exchange(true)) return;
+    writer = new std::thread(&McuEmulator::streamLDMaps, this);
+    reader = new std::thread(&McuEmulator::readCommands, this);
+}
+
+void McuEmulator::stop()
+{
+    running = false;
+    for (std::thread **thread : {&writer, &reader})
+    {
+        if (*thread != nullptr)
+        {
+            (*thread)->join();
+            delete *thread;
+            *thread = nullptr;
+        }
+    }
+}
+
+McuEmulator::Stats McuEmulator::getStats() const
+{
+    Stats stats;
+    stats.ldmaps_sent = ldmaps_sent;
+    stats.ldmaps_corrupted = ldmaps_corrupted;
+    stats.commands_received = commands_received;
+    stats.command_errors = command_errors;
+    return stats;
+}
+
+/**
+ * Writes everything, waiting for room while the slave side is not reading
+ * @return false if stopped or the PTY failed
+ */
+bool McuEmulator::writeAll(const uint8_t *data, size_t size)
+{
+    while (size > 0 && running)
+    {
+        ssize_t n = write(master, data, size);
+        if (n > 0)
+        {
+            data += n;
+            size -= n;
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EIO) return false;
+
+        // EIO: nobody has the slave open yet
+        struct pollfd fd = {master, POLLOUT, 0};
+        poll(&fd, 1, POLL_MS);
+    }
+    return size == 0;
+}
+
+/**
+ * Sends LDMap frames on absolute deadlines so the rate does not drift
+ */
+void McuEmulator::streamLDMaps()
+{
+    if (params.ldmap_hz <= 0) return;
+
+    std::mt19937 rng(params.seed);
+    std::bernoulli_distribution corrupt(params.corruption);
+    std::bernoulli_distribution noisy(params.garbage);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<int> gap(1, 8);
+
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / params.ldmap_hz));
+    Clock::time_point begin = Clock::now();
+    Clock::time_point next = begin;
+    uint8_t frame[LDMapParser::FRAME_SIZE + 8];
+    uint32_t sequence = 0;
+
+    while (running)
+    {
+        std::this_thread::sleep_until(next);
+        next += period;
+
+        size_t size = 0;
+        if (noisy(rng))
+        {
+            for (int k = gap(rng); k > 0; k--)
+            {
+                uint8_t b = byte(rng);
+                frame[size++] = b == UART_FIRST_BYTE ? 0 : b;
+            }
+        }
+
+        LDMap ldmap;
+        memset(&ldmap, 0, sizeof(LDMap));
+        ldmap.id = sequence & 0xff;
+        ldmap.members = 1;
+        ldmap.timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - begin).count();
+        size += LDMapParser::frame(ldmap, frame + size);
+        if (corrupt(rng))
+        {
+            frame[size - 1]++;
+            ldmaps_corrupted++;
+        }
+        sequence++;
+
+        if (!writeAll(frame, size)) break;
+        ldmaps_sent++;
+    }
+}
+
+/**
+ * Decodes command frames as they arrive
+ */
+void McuEmulator::readCommands()
+{
+    std::vector<uint8_t> pending;
+    uint8_t chunk[512];
+
+    while (running)
+    {
+        struct pollfd fd = {master, POLLIN, 0};
+        if (poll(&fd, 1, POLL_MS) <= 0) continue;
+
+        ssize_t n = read(master, chunk, sizeof(chunk));
+        Clock::time_point arrival = Clock::now();
+        if (n <= 0)
+        {
+            // EIO until the slave side is opened
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+            continue;
+        }
+        pending.insert(pending.end(), chunk, chunk + n);
+
+        size_t pos = 0;
+        while (pending.size() - pos >= COMMAND_FRAME_SIZE)
+        {
+            const uint8_t *f = pending.data() + pos;
+            if (f[0] != UART_FIRST_BYTE || f[1] != UART_SECOND_BYTE || f[2] != sizeof(UARTCommand))
+            {
+                pos++;
+                continue;
+            }
+
+            uint8_t ch = 0;
+            for (size_t k = 0; k < sizeof(UARTCommand); k++)
+            {
+                ch += f[3 + k];
+            }
+            const uint8_t *trailer = f + 3 + sizeof(UARTCommand);
+            if (trailer[0] != ch || trailer[1] != '\r' || trailer[2] != '\n')
+            {
+                command_errors++;
+                pos++;
+                continue;
+            }
+
+            UARTCommand command;
+            memcpy(&command, f + 3, sizeof(UARTCommand));
+            commands_received++;
+            if (command_callback) command_callback(command, arrival);
+            pos += COMMAND_FRAME_SIZE;
+        }
+        pending.erase(pending.begin(), pending.begin() + pos);
+    }
+}
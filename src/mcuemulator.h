@@ -0,0 +1,76 @@
+#ifndef MCUEMULATOR_H
+#define MCUEMULATOR_H
+
+#include "uartcommander.h"
+#include "ldmap.h"
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+/**
+ * Stands in for the vehicle MCU on a pseudo-terminal.
+ *
+ * Opens a PTY pair and speaks the board's framing on the master side:
+ * streams LDMap frames at a fixed rate (optionally with corrupted checksums
+ * and garbage between frames) and decodes the UARTCommand frames written by
+ * SerialCommunication, stamping each with its arrival time. Point
+ * SerialCommunication at getPortName() to use it.
+ */
+class McuEmulator
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Params
+    {
+        double ldmap_hz = 50.0;  // LDMap frames per second, 0 to send none
+        double corruption = 0.0; // probability that a frame gets a bad checksum
+        double garbage = 0.0;    // probability of random bytes before a frame
+        uint32_t seed = 1;
+    };
+
+    struct Stats
+    {
+        uint64_t ldmaps_sent;       // frames written, corrupted ones included
+        uint64_t ldmaps_corrupted;  // frames written with a bad checksum
+        uint64_t commands_received; // valid command frames decoded
+        uint64_t command_errors;    // command frames with a bad checksum or trailer
+    };
+
+    McuEmulator(const Params &params);
+    virtual ~McuEmulator();
+
+    bool isOpen() const;
+    const std::string& getPortName() const;
+
+    void onCommand(std::function<void(const UARTCommand&, Clock::time_point)> callback);
+    void start();
+    void stop();
+    Stats getStats() const;
+
+private:
+    Params params;
+    int master;
+    std::string port_name;
+
+    std::function<void(const UARTCommand&, Clock::time_point)> command_callback;
+    std::thread *writer = nullptr;
+    std::thread *reader = nullptr;
+    std::atomic<bool> running;
+
+    std::atomic<uint64_t> ldmaps_sent;
+    std::atomic<uint64_t> ldmaps_corrupted;
+    std::atomic<uint64_t> commands_received;
+    std::atomic<uint64_t> command_errors;
+
+    void streamLDMaps();
+    void readCommands();
+    bool writeAll(const uint8_t *data, size_t size);
+};
+
+#endif
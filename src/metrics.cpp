@@ -0,0 +1,310 @@
+#include "metrics.h"
+
+#include <libconfig.h++>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+//-----HISTOGRAM-----//
+
+Histogram::Histogram()
+    : count(0), sum(0), max(0)
+{
+    for (std::atomic<uint64_t> &b : buckets) b = 0;
+}
+
+/**
+ * Maps a value to its bucket: values below SUB_BUCKETS map to themselves,
+ * larger values to (exponent, top SUB_BITS bits after the leading one).
+ */
+int Histogram::bucket(uint64_t value)
+{
+    if (value < SUB_BUCKETS) return value;
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (value >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+/**
+ * @return largest value that falls into a bucket
+ */
+uint64_t Histogram::upper(int bucket)
+{
+    if (bucket < SUB_BUCKETS) return bucket;
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    uint64_t sub = bucket % SUB_BUCKETS;
+    uint64_t low = (1ull << exponent) | (sub << (exponent - SUB_BITS));
+    return low + (1ull << (exponent - SUB_BITS)) - 1;
+}
+
+void Histogram::record(uint64_t value)
+{
+    buckets[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed));
+}
+
+/**
+ * Computes quantiles from the buckets. Concurrent records may or may not be
+ * included; each quantile reports the upper edge of its bucket.
+ */
+Histogram::Summary Histogram::summarize() const
+{
+    Summary summary;
+    uint64_t counts[BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    summary.count = total;
+    summary.mean = total > 0 ? (double)sum.load(std::memory_order_relaxed) / total : 0;
+    summary.max = max.load(std::memory_order_relaxed);
+
+    const double quantiles[] = {0.50, 0.95, 0.99};
+    uint64_t *results[] = {&summary.p50, &summary.p95, &summary.p99};
+    for (int q = 0; q < 3; q++)
+    {
+        uint64_t rank = (uint64_t)(quantiles[q] * total + 0.5);
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        *results[q] = 0;
+        for (int i = 0; i < BUCKETS && total > 0; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                *results[q] = std::min(upper(i), summary.max);
+                break;
+            }
+        }
+    }
+    return summary;
+}
+
+/**
+ * Clears every bucket. Samples recorded concurrently may be partially kept.
+ */
+void Histogram::reset()
+{
+    for (std::atomic<uint64_t> &b : buckets) b.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+//-----METRICS-----//
+
+Metrics::Metrics()
+    : on(false), running(false)
+{
+}
+
+Metrics::~Metrics()
+{
+    stop();
+}
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+/**
+ * Reads the metrics section of a config file:
+ *   metrics = { enabled = true; file = "metrics.json"; format = "json"; period = 1000; };
+ * and starts the periodic dump if enabled.
+ * @param config_path path to config file
+ */
+void Metrics::configure(const std::string &config_path)
+{
+    libconfig::Config cfg;
+    try
+    {
+        cfg.readFile(config_path.c_str());
+        if (!cfg.exists("metrics")) return;
+
+        bool enable = false;
+        cfg.lookupValue("metrics.enabled", enable);
+        if (!enable) return;
+
+        std::string name = "metrics.json";
+        cfg.lookupValue("metrics.file", name);
+        std::string type = "json";
+        cfg.lookupValue("metrics.format", type);
+        int ms = 1000;
+        cfg.lookupValue("metrics.period", ms);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        path = name;
+        format = type == "csv" ? CSV : JSON;
+        period = std::chrono::milliseconds(ms > 0 ? ms : 1000);
+    }
+    catch(...)
+    {
+        std::cerr << "Invalid config file" << std::endl;
+        return;
+    }
+
+    on = true;
+    if (!running.exchange(true))
+    {
+        dump_thread = new std::thread(&Metrics::run, this);
+    }
+}
+
+/**
+ * Turns recording on or off without a periodic dump, e.g. for benchmarks that
+ * read the instruments themselves
+ */
+void Metrics::enable(bool on)
+{
+    this->on = on;
+}
+
+/**
+ * Clears every histogram and counter
+ */
+void Metrics::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Named<Histogram> &named : histograms) named.instrument->reset();
+    for (Named<Counter> &named : counters) named.instrument->reset();
+}
+
+/**
+ * Stops the periodic dump after writing a final snapshot
+ */
+void Metrics::stop()
+{
+    if (running.exchange(false) && dump_thread != nullptr)
+    {
+        dump_thread->join();
+        dump();
+    }
+    delete dump_thread;
+    dump_thread = nullptr;
+}
+
+void Metrics::run()
+{
+    auto next = std::chrono::steady_clock::now() + period;
+    while (running)
+    {
+        // Sleep in short slices so stop() does not wait a whole period
+        while (running && std::chrono::steady_clock::now() < next)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (!running) break;
+        dump();
+        next += period;
+    }
+}
+
+/**
+ * Gets the histogram with the given name, creating it on first use. The
+ * reference stays valid for the lifetime of the process.
+ */
+Histogram& Metrics::histogram(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Named<Histogram> &named : histograms)
+    {
+        if (named.name == name) return *named.instrument;
+    }
+    histograms.push_back(Named<Histogram>{name, std::unique_ptr<Histogram>(new Histogram())});
+    return *histograms.back().instrument;
+}
+
+/**
+ * Gets the counter with the given name, creating it on first use. The
+ * reference stays valid for the lifetime of the process.
+ */
+Counter& Metrics::counter(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Named<Counter> &named : counters)
+    {
+        if (named.name == name) return *named.instrument;
+    }
+    counters.push_back(Named<Counter>{name, std::unique_ptr<Counter>(new Counter())});
+    return *counters.back().instrument;
+}
+
+/**
+ * Formats every instrument.
+ * JSON: one object per snapshot, {"time_ms":..,"histograms":{name:{..}},"counters":{name:n}}
+ * CSV: one row per instrument, time_ms,name,count,mean,p50,p95,p99,max
+ */
+std::string Metrics::snapshot(Format format) const
+{
+    long long time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    if (format == JSON)
+    {
+        out << "{\"time_ms\":" << time_ms << ",\"histograms\":{";
+        for (size_t i = 0; i < histograms.size(); i++)
+        {
+            Histogram::Summary s = histograms[i].instrument->summarize();
+            out << (i ? "," : "") << "\"" << histograms[i].name << "\":{"
+                << "\"count\":" << s.count << ",\"mean\":" << s.mean
+                << ",\"p50\":" << s.p50 << ",\"p95\":" << s.p95
+                << ",\"p99\":" << s.p99 << ",\"max\":" << s.max << "}";
+        }
+        out << "},\"counters\":{";
+        for (size_t i = 0; i < counters.size(); i++)
+        {
+            out << (i ? "," : "") << "\"" << counters[i].name << "\":" << counters[i].instrument->get();
+        }
+        out << "}}\n";
+    }
+    else
+    {
+        for (const Named<Histogram> &named : histograms)
+        {
+            Histogram::Summary s = named.instrument->summarize();
+            out << time_ms << "," << named.name << "," << s.count << "," << s.mean << ","
+                << s.p50 << "," << s.p95 << "," << s.p99 << "," << s.max << "\n";
+        }
+        for (const Named<Counter> &named : counters)
+        {
+            uint64_t n = named.instrument->get();
+            out << time_ms << "," << named.name << "," << n << ",,,,,\n";
+        }
+    }
+    return out.str();
+}
+
+/**
+ * Appends a snapshot to the configured file
+ */
+void Metrics::dump()
+{
+    if (path.empty()) return;
+
+    std::string text = snapshot(format);
+    std::ofstream file(path, std::ios::app);
+    if (!file)
+    {
+        std::cerr << "Could not write metrics to " << path << std::endl;
+        return;
+    }
+    if (format == CSV && !header_written)
+    {
+        file << "time_ms,name,count,mean,p50,p95,p99,max\n";
+    }
+    header_written = true;
+    file << text;
+}
@@ -0,0 +1,153 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Log-linear histogram of non-negative integer samples (latencies in ns,
+ * hit counts, ...). Values below 16 get a bucket each; above that every power
+ * of two is split into 16 linear buckets, so quantiles are accurate to about
+ * 6%. Recording is a few relaxed atomic increments and never locks, so any
+ * number of threads may record while another one reads.
+ */
+class Histogram
+{
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+    struct Summary
+    {
+        uint64_t count;
+        double mean;
+        uint64_t p50;
+        uint64_t p95;
+        uint64_t p99;
+        uint64_t max;
+    };
+
+    Histogram();
+
+    void record(uint64_t value);
+    Summary summarize() const;
+    void reset();
+
+private:
+    static int bucket(uint64_t value);
+    static uint64_t upper(int bucket);
+
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> max;
+};
+
+/**
+ * Monotonic event counter
+ */
+class Counter
+{
+public:
+    Counter() : value(0) {}
+
+    void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+    void reset() { value.store(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value;
+};
+
+/**
+ * Process-wide registry of named histograms and counters.
+ *
+ * Instruments are looked up once (under a lock) and then recorded into
+ * without locking. When the `metrics` section of the config file enables it,
+ * a background thread appends a snapshot of every instrument to a JSON lines
+ * or CSV file at a fixed period.
+ */
+class Metrics
+{
+public:
+    enum Format { JSON, CSV };
+
+    static Metrics& instance();
+
+    static bool enabled() { return instance().on.load(std::memory_order_relaxed); }
+
+    void configure(const std::string &config_path);
+    void enable(bool on);
+    void reset();
+    void stop();
+
+    Histogram& histogram(const std::string &name);
+    Counter& counter(const std::string &name);
+
+    std::string snapshot(Format format) const;
+    void dump();
+
+private:
+    Metrics();
+    ~Metrics();
+
+    void run();
+
+    template <typename T>
+    struct Named
+    {
+        std::string name;
+        std::unique_ptr<T> instrument;
+    };
+
+    std::vector<Named<Histogram>> histograms;
+    std::vector<Named<Counter>> counters;
+    mutable std::mutex mutex;
+
+    std::atomic<bool> on;
+    std::string path;
+    Format format = JSON;
+    std::chrono::milliseconds period{1000};
+    bool header_written = false;
+
+    std::atomic<bool> running;
+    std::thread *dump_thread = nullptr;
+};
+
+/**
+ * Records the lifetime of the object into a histogram, in nanoseconds.
+ * Does nothing while metrics are disabled.
+ */
+class ScopedTimer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    ScopedTimer(Histogram &histogram)
+        : histogram(histogram), active(Metrics::enabled())
+    {
+        if (active) begin = Clock::now();
+    }
+
+    ~ScopedTimer()
+    {
+        if (active)
+        {
+            histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+        }
+    }
+
+private:
+    Histogram &histogram;
+    bool active;
+    Clock::time_point begin;
+};
+
+#endif
@@ -3,8 +3,11 @@
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "pid.h"
 
+#define MAX_PERIODS 4 // longest interval passed on, in nominal intervals; a stall beyond it must not wind up the integral
+
 using namespace std;
 
 class PIDImpl
@@ -12,7 +15,8 @@ class PIDImpl
     public:
         PIDImpl( double dt, double max, double min, double Kp, double Kd, double Ki );
         ~PIDImpl();
-        double calculate( double setpoint, double pv );
+        double dt() const { return _dt; }
+        double calculate( double setpoint, double pv, double dt );
 
     private:
         double _dt;
@@ -32,12 +36,21 @@ PID::PID( double dt, double max, double min, double Kp, double Kd, double Ki )
 }
 double PID::calculate( double setpoint, double pv )
 {
-    return pimpl->calculate(setpoint,pv);
+    return pimpl->calculate(setpoint,pv,pimpl->dt());
+}
+double PID::calculate( double setpoint, double pv, double dt )
+{
+    return pimpl->calculate(setpoint,pv,dt);
 }
 PID::~PID() 
 {
     delete pimpl;
 }
+double PID::interval( int64_t last_ns, int64_t now_ns, double dt )
+{
+    if (last_ns <= 0 || now_ns <= last_ns) return dt;
+    return std::min((now_ns - last_ns) / 1e9, MAX_PERIODS * dt);
+}
 
 
 /**
@@ -55,7 +68,7 @@ PIDImpl::PIDImpl( double dt, double max, double min, double Kp, double Kd, doubl
 {
 }
 
-double PIDImpl::calculate( double setpoint, double pv )
+double PIDImpl::calculate( double setpoint, double pv, double dt )
 {
     
     // Calculate error
@@ -65,11 +78,11 @@ double PIDImpl::calculate( double setpoint, double pv )
     double Pout = _Kp * error;
 
     // Integral term
-    _integral += error * _dt;
+    _integral += error * dt;
     double Iout = _Ki * _integral;
 
     // Derivative term
-    double derivative = (error - _pre_error) / _dt;
+    double derivative = (error - _pre_error) / dt;
     double Dout = _Kd * derivative;
 
     // Calculate total output
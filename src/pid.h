@@ -1,6 +1,8 @@
 #ifndef _PID_H_
 #define _PID_H_
 
+#include <cstdint>
+
 class PIDImpl;
 class PID
 {
@@ -15,6 +17,13 @@ class PID
 
         // Returns the manipulated variable given a setpoint and current process value
         double calculate( double setpoint, double pv );
+
+        // Same, for a loop whose interval varies, e.g. driven from recorded timestamps
+        double calculate( double setpoint, double pv, double dt );
+
+        // Interval between two cycles stamped on a monotonic clock, ns: dt for
+        // the first cycle, and never more than a few nominal intervals
+        static double interval( int64_t last_ns, int64_t now_ns, double dt );
         ~PID();
 
     private:
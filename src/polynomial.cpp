@@ -0,0 +1,97 @@
+#include "polynomial.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define POLY_LANES 4
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define POLY_LANES 2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define POLY_LANES 2
+#else
+#define POLY_LANES 1
+#endif
+
+/**
+ * Evaluates a polynomial at POLY_LANES inputs at once. Multiplies and adds
+ * are kept separate so results match polynomial() bit for bit when the
+ * compiler does not contract it into fused multiply-adds.
+ */
+static inline void horner(const double *params, int degree, const double *x, double *out)
+{
+#if defined(__AVX__)
+    __m256d vx = _mm256_loadu_pd(x);
+    __m256d v = _mm256_setzero_pd();
+    for (int i = degree - 1; i >= 0; i--)
+    {
+        v = _mm256_add_pd(_mm256_mul_pd(v, vx), _mm256_set1_pd(params[i]));
+    }
+    _mm256_storeu_pd(out, v);
+#elif defined(__SSE2__)
+    __m128d vx = _mm_loadu_pd(x);
+    __m128d v = _mm_setzero_pd();
+    for (int i = degree - 1; i >= 0; i--)
+    {
+        v = _mm_add_pd(_mm_mul_pd(v, vx), _mm_set1_pd(params[i]));
+    }
+    _mm_storeu_pd(out, v);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    float64x2_t vx = vld1q_f64(x);
+    float64x2_t v = vdupq_n_f64(0.0);
+    for (int i = degree - 1; i >= 0; i--)
+    {
+        v = vaddq_f64(vmulq_f64(v, vx), vdupq_n_f64(params[i]));
+    }
+    vst1q_f64(out, v);
+#else
+    out[0] = polynomial(params, degree, x[0]);
+#endif
+}
+
+/**
+ * Evaluates left and right lane polynomials for a batch of rows.
+ * @param lparams left lane coefficients
+ * @param rparams right lane coefficients
+ * @param degree number of coefficients of each lane
+ * @param rows rows to evaluate at
+ * @param count number of rows
+ * @param left receives the left lane column for each row
+ * @param right receives the right lane column for each row
+ */
+void lanePositions(const double *lparams, const double *rparams, int degree,
+        const double *rows, int count, double *left, double *right)
+{
+    int i = 0;
+    for (; i + POLY_LANES <= count; i += POLY_LANES)
+    {
+        horner(lparams, degree, rows + i, left + i);
+        horner(rparams, degree, rows + i, right + i);
+    }
+    for (; i < count; i++)
+    {
+        left[i] = polynomial(lparams, degree, rows[i]);
+        right[i] = polynomial(rparams, degree, rows[i]);
+    }
+}
+
+/**
+ * Evaluates one polynomial for a batch of inputs.
+ * @param params coefficients, lowest power first
+ * @param degree number of coefficients
+ * @param xs inputs
+ * @param count number of inputs
+ * @param out receives the value for each input
+ */
+void polynomials(const double *params, int degree, const double *xs, int count, double *out)
+{
+    int i = 0;
+    for (; i + POLY_LANES <= count; i += POLY_LANES)
+    {
+        horner(params, degree, xs + i, out + i);
+    }
+    for (; i < count; i++)
+    {
+        out[i] = polynomial(params, degree, xs[i]);
+    }
+}
@@ -0,0 +1,30 @@
+/**
+ * Provides polynomial evaluation for lane curves.
+ */
+
+#ifndef POLYNOMIAL_H
+#define POLYNOMIAL_H
+
+/**
+ * Evaluates a polynomial expression with Horner's method
+ * @param params Array of polynomial coefficients, lowest power first
+ * @param degree Number of coefficients (size of params)
+ * @param x Polynomial input
+ * @return Evaluated expression.
+ */
+inline double polynomial(const double *params, int degree, double x)
+{
+    double val = 0;
+    for (int i = degree - 1; i >= 0; i--)
+    {
+        val = val * x + params[i];
+    }
+    return val;
+}
+
+void polynomials(const double *params, int degree, const double *xs, int count, double *out);
+
+void lanePositions(const double *lparams, const double *rparams, int degree,
+        const double *rows, int count, double *left, double *right);
+
+#endif
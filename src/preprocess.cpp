@@ -0,0 +1,142 @@
+#include "preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+
+// Half the size of the gaussian kernel used by thresh()
+#define BLUR_RADIUS 3
+
+/**
+ * Builds the lookup table for a birdseye warp.
+ * @param birdseye perspective transform from camera to birdseye view
+ * @param width width of both the camera frame and the birdseye mask
+ * @param height height of both the camera frame and the birdseye mask
+ * @param threshold binary threshold applied to the blurred grayscale image
+ */
+Preprocessor::Preprocessor(const cv::Mat &birdseye, int width, int height, int threshold)
+    : width(width), height(height), spans(height)
+{
+    for (int i = 0; i < 256; i++)
+    {
+        table[i] = i > threshold ? 255 : 0;
+    }
+
+    // warpPerspective samples the source at inverse(M) * dst
+    Mat m;
+    birdseye.convertTo(m, CV_64F);
+    m = m.inv();
+    const double *h = m.ptr<double>(0);
+
+    std::vector<int> src(width * height, -1);
+    int top = height, bottom = -1, left = width, right = -1;
+    for (int y = 0; y < height; y++)
+    {
+        Span &span = spans[y];
+        span.begin = width;
+        span.end = 0;
+        for (int x = 0; x < width; x++)
+        {
+            double w = h[6] * x + h[7] * y + h[8];
+            if (w == 0) continue;
+            int u = (int)std::floor((h[0] * x + h[1] * y + h[2]) / w + 0.5);
+            int v = (int)std::floor((h[3] * x + h[4] * y + h[5]) / w + 0.5);
+            if (u < 0 || u >= width || v < 0 || v >= height) continue;
+
+            src[y * width + x] = v * width + u;
+            span.begin = std::min(span.begin, x);
+            span.end = std::max(span.end, x + 1);
+            top = std::min(top, v);
+            bottom = std::max(bottom, v);
+            left = std::min(left, u);
+            right = std::max(right, u);
+        }
+    }
+
+    if (bottom < 0)
+    {
+        roi = Rect(0, 0, 0, 0);
+        return;
+    }
+
+    top = std::max(top - BLUR_RADIUS, 0);
+    bottom = std::min(bottom + BLUR_RADIUS, height - 1);
+    left = std::max(left - BLUR_RADIUS, 0);
+    right = std::min(right + BLUR_RADIUS, width - 1);
+    roi = Rect(left, top, right - left + 1, bottom - top + 1);
+
+    // Rebase source offsets onto the roi; the trapezoid is convex so each
+    // birdseye row has at most one span and holes inside it cannot occur
+    lut.assign(width * height, 0);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = spans[y].begin; x < spans[y].end; x++)
+        {
+            int s = src[y * width + x];
+            if (s < 0) continue;
+            lut[y * width + x] = (s / width - top) * roi.width + (s % width - left);
+        }
+    }
+
+    gray.create(roi.size(), CV_8UC1);
+    blurred.create(roi.size(), CV_8UC1);
+}
+
+/**
+ * Thresholds and warps a frame to a binary birdseye mask.
+ * @param frame BGR camera frame of the size given to the constructor
+ * @param dst destination mask (CV_8UC1, reallocated only if the size differs)
+ */
+void Preprocessor::apply(const cv::Mat &frame, cv::Mat &dst)
+{
+    dst.create(height, width, CV_8UC1);
+    if (roi.area() == 0)
+    {
+        dst = Scalar(0);
+        return;
+    }
+
+    cvtColor(frame(roi), gray, CV_BGR2GRAY);
+    GaussianBlur(gray, blurred, Size(2 * BLUR_RADIUS + 1, 2 * BLUR_RADIUS + 1), 1.5, 1.5);
+
+    const uchar *src = blurred.ptr<uchar>(0);
+    for (int y = 0; y < height; y++)
+    {
+        uchar *row = dst.ptr<uchar>(y);
+        const int *offsets = &lut[y * width];
+        const Span &span = spans[y];
+
+        if (span.begin >= span.end)
+        {
+            std::fill(row, row + width, 0);
+            continue;
+        }
+
+        std::fill(row, row + span.begin, 0);
+        for (int x = span.begin; x < span.end; x++)
+        {
+            row[x] = table[src[offsets[x]]];
+        }
+        std::fill(row + span.end, row + width, 0);
+    }
+}
+
+const cv::Rect& Preprocessor::getRoi() const { return roi; }
+
+/**
+ * Thresholds the image.
+ * Process:
+ *   1. Convert image to grayscale
+ *   2. Blur the image to remove noise (gaussian)
+ *   3. threshold image (binary)
+ * @param src image to threshold
+ * @param dst destination for thresholded image
+ * @param threshold binary threshold
+ */
+void thresh(const cv::Mat &src, cv::Mat &dst, int threshold)
+{
+    cv::cvtColor(src, dst, CV_BGR2GRAY);
+    cv::GaussianBlur(dst, dst, Size( 7, 7 ), 1.5, 1.5 );
+    cv::threshold(dst, dst, threshold, 255, THRESH_BINARY);
+}
@@ -0,0 +1,46 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include "opencv2/opencv.hpp"
+
+#include <vector>
+
+void thresh(const cv::Mat &src, cv::Mat &dst, int threshold);
+
+/**
+ * Turns camera frames into the binary birdseye mask searched by Detector.
+ *
+ * Equivalent to thresh() followed by warpPerspective(), except that the
+ * perspective warp is baked into an integer lookup table when the object is
+ * built. Per frame only the band of the camera image that the warp reads from
+ * is converted to grayscale and blurred, and the mask is written in a single
+ * gather pass that thresholds while it warps. Pixels are sampled with nearest
+ * neighbour instead of bilinear interpolation.
+ */
+class Preprocessor
+{
+private:
+    struct Span
+    {
+        int begin; // first birdseye column that maps into the camera image
+        int end;   // one past the last such column
+    };
+
+    int width;
+    int height;
+    cv::Rect roi;          // band of the camera frame read by the warp, with blur margin
+    std::vector<Span> spans; // valid columns per birdseye row
+    std::vector<int> lut;  // per birdseye pixel: offset into the blurred roi
+    uchar table[256];      // threshold as a lookup so the gather stays branch free
+
+    cv::Mat gray;
+    cv::Mat blurred;
+
+public:
+    Preprocessor(const cv::Mat &birdseye, int width, int height, int threshold);
+
+    void apply(const cv::Mat &frame, cv::Mat &dst);
+    const cv::Rect& getRoi() const;
+};
+
+#endif
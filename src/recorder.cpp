@@ -0,0 +1,189 @@
+#include "recorder.h"
+
+#include <libconfig.h++>
+#include <iostream>
+#include <chrono>
+
+#define DEFAULT_QUEUE 8 // frame buffers shared by all streams
+
+static const char *stream_names[Recorder::STREAM_COUNT] = {"raw", "overlay", "birdseye"};
+
+/**
+ * Reads the record section of a config file:
+ *   record = { raw = "raw.avi"; overlay = ""; birdseye = ""; codec = "MJPG";
+ *              fps = 10.0; decimation = 1; queue = 8; };
+ * and starts the encoder thread if any stream is enabled.
+ * @param config_path path to config file
+ */
+Recorder::Recorder(std::string config_path)
+    : fourcc(CV_FOURCC('M', 'J', 'P', 'G')), fps(10.0), decimation(1),
+      encoded_counter(Metrics::instance().counter("recorder.encoded")),
+      dropped_counter(Metrics::instance().counter("recorder.dropped")),
+      running(false)
+{
+    for (int i = 0; i < STREAM_COUNT; i++)
+    {
+        failed[i] = false;
+        encoded[i] = 0;
+        dropped[i] = 0;
+    }
+
+    int queue = DEFAULT_QUEUE;
+    libconfig::Config cfg;
+    try
+    {
+        cfg.readFile(config_path.c_str());
+        if (!cfg.exists("record")) return;
+
+        for (int i = 0; i < STREAM_COUNT; i++)
+        {
+            cfg.lookupValue((std::string("record.") + stream_names[i]).c_str(), paths[i]);
+        }
+        std::string codec;
+        if (cfg.lookupValue("record.codec", codec) && codec.size() == 4)
+        {
+            fourcc = CV_FOURCC(codec[0], codec[1], codec[2], codec[3]);
+        }
+        cfg.lookupValue("record.fps", fps);
+        cfg.lookupValue("record.decimation", decimation);
+        cfg.lookupValue("record.queue", queue);
+    }
+    catch(...)
+    {
+        std::cerr << "Invalid config file" << std::endl;
+        return;
+    }
+    if (decimation < 1) decimation = 1;
+    if (queue < 1) queue = 1;
+    if (!isEnabled()) return;
+
+    // Buffers are allocated on first use and then reused for frames of the same size
+    pool.resize(queue);
+    free_slots = new SpscQueue<int>(queue);
+    filled = new SpscQueue<int>(queue);
+    for (int i = 0; i < queue; i++)
+    {
+        free_slots->push(i);
+    }
+
+    running = true;
+    encoder = new std::thread(&Recorder::run, this);
+}
+
+/**
+ * Encodes the frames still queued, then closes the files
+ */
+Recorder::~Recorder()
+{
+    running = false;
+    if (encoder != nullptr)
+    {
+        encoder->join();
+        delete encoder;
+    }
+    for (cv::VideoWriter &writer : writers)
+    {
+        writer.release();
+    }
+    delete free_slots;
+    delete filled;
+}
+
+bool Recorder::isEnabled() const
+{
+    for (int i = 0; i < STREAM_COUNT; i++)
+    {
+        if (isEnabled((Stream)i)) return true;
+    }
+    return false;
+}
+
+bool Recorder::isEnabled(Stream stream) const
+{
+    return !paths[stream].empty();
+}
+
+/**
+ * Starts a new frame. Call once per detected frame before push().
+ * @return true if this frame should be recorded, false if decimation skips it
+ */
+bool Recorder::nextFrame()
+{
+    return frames++ % decimation == 0;
+}
+
+/**
+ * Queues a copy of a frame for encoding. Never waits: if the encoder has no
+ * free buffer the frame is dropped. Call from one thread only.
+ * @param stream file to write the frame to
+ * @param frame 8-bit frame, 3 channels or 1 for the birdseye mask
+ * @return false if the stream is disabled or the frame was dropped
+ */
+bool Recorder::push(Stream stream, const cv::Mat &frame)
+{
+    if (!isEnabled(stream) || failed[stream] || encoder == nullptr || frame.empty()) return false;
+
+    int index;
+    if (!free_slots->pop(index))
+    {
+        dropped[stream]++;
+        dropped_counter.add();
+        return false;
+    }
+    Slot &slot = pool[index];
+    slot.stream = stream;
+    frame.copyTo(slot.frame);
+    filled->push(index);
+    return true;
+}
+
+Recorder::Stats Recorder::getStats(Stream stream) const
+{
+    Stats stats;
+    stats.encoded = encoded[stream];
+    stats.dropped = dropped[stream];
+    return stats;
+}
+
+void Recorder::run()
+{
+    int index;
+    while (true)
+    {
+        if (filled->pop(index))
+        {
+            encode(pool[index]);
+            free_slots->push(index);
+        }
+        else if (!running)
+        {
+            break;
+        }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+/**
+ * Writes a frame, opening the stream's file with the size of its first frame
+ */
+void Recorder::encode(Slot &slot)
+{
+    if (failed[slot.stream]) return;
+    cv::VideoWriter &writer = writers[slot.stream];
+    if (!writer.isOpened())
+    {
+        writer.open(paths[slot.stream], fourcc, fps, slot.frame.size(), slot.frame.channels() == 3);
+        if (!writer.isOpened())
+        {
+            std::cerr << "Could not open " << paths[slot.stream] << " for recording" << std::endl;
+            failed[slot.stream] = true;
+            return;
+        }
+    }
+    writer.write(slot.frame);
+    encoded[slot.stream]++;
+    encoded_counter.add();
+}
@@ -0,0 +1,76 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include "opencv2/opencv.hpp"
+#include "spsc.h"
+#include "metrics.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Writes camera frames, lane overlays and birdseye masks to video files on
+ * its own thread.
+ *
+ * Frames are copied into a fixed pool of preallocated buffers and handed to
+ * the encoder thread through a lock-free queue. When every buffer is waiting
+ * to be encoded the frame is dropped, so the detection thread never waits for
+ * the encoder. Every n-th frame is recorded (decimation). Configured by the
+ * `record` section of the config file; streams with an empty file name are
+ * not recorded.
+ */
+class Recorder
+{
+public:
+    enum Stream { RAW, OVERLAY, BIRDSEYE, STREAM_COUNT };
+
+    struct Stats
+    {
+        uint64_t encoded; // frames written to the file
+        uint64_t dropped; // frames discarded because the encoder fell behind
+    };
+
+    Recorder(std::string config_path);
+    virtual ~Recorder();
+
+    bool isEnabled() const;
+    bool isEnabled(Stream stream) const;
+    bool nextFrame();
+    bool push(Stream stream, const cv::Mat &frame);
+    Stats getStats(Stream stream) const;
+
+private:
+    struct Slot
+    {
+        Stream stream;
+        cv::Mat frame;
+    };
+
+    std::string paths[STREAM_COUNT];
+    cv::VideoWriter writers[STREAM_COUNT];
+    int fourcc;
+    double fps;
+    int decimation;
+    uint64_t frames = 0; // frames offered through nextFrame()
+
+    std::vector<Slot> pool;
+    SpscQueue<int> *free_slots = nullptr; // pool indices, encoder -> producer
+    SpscQueue<int> *filled = nullptr;     // pool indices, producer -> encoder
+
+    std::atomic<bool> failed[STREAM_COUNT]; // file could not be opened
+    std::atomic<uint64_t> encoded[STREAM_COUNT];
+    std::atomic<uint64_t> dropped[STREAM_COUNT];
+    Counter &encoded_counter;
+    Counter &dropped_counter;
+
+    std::atomic<bool> running;
+    std::thread *encoder = nullptr;
+
+    void run();
+    void encode(Slot &slot);
+};
+
+#endif
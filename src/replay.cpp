@@ -0,0 +1,232 @@
+/**
+ * replay.cpp
+ * Replays a recorded run through Detector, Lane and PID as fast as the CPU
+ * allows. Time is simulated: frame i happens at the time_ns of telemetry
+ * record i and every LDMap logged up to that time is delivered before it.
+ * Nothing sleeps and only the speed report reads a clock, so replaying the
+ * same inputs always gives bit-identical results; the hash printed at the end is the
+ * quick way to check that.
+ *
+ * Usage: replay <config file> <video file> [telemetry log or -] [ldmap log or -] [output log]
+ *   video file:    frames of the run, one per telemetry record (a video.file
+ *                  run, or the raw stream recorded with record.decimation = 1)
+ *   telemetry log: telemetry.file of the run; without it frames are spaced
+ *                  by the nominal loop interval
+ *   ldmap log:     telemetry.ldmap_file of the run
+ *   output log:    telemetry log of the replay, same format, for telemetry_csv
+ *
+ * Detector runs sequentially (Detector::step()) whatever detector.pipeline
+ * says, and the record section of the config is ignored.
+ */
+
+using namespace std;
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unistd.h>
+#include <libconfig.h++>
+
+#include "opencv2/opencv.hpp"
+
+#include "detector.h"
+#include "helpers.h"
+#include "pid.h"
+#include "telemetry.h"
+
+using namespace cv;
+
+#define TIMEOUT 500 // nominal loop interval of detect, ms
+
+/**
+ * @return true if both records hold the same lane, radius and command, bit for bit
+ */
+bool same_output(const TelemetryRecord &a, const TelemetryRecord &b)
+{
+    return a.degree == b.degree &&
+           memcmp(a.left, b.left, sizeof(a.left)) == 0 &&
+           memcmp(a.right, b.right, sizeof(a.right)) == 0 &&
+           memcmp(&a.radius, &b.radius, sizeof(a.radius)) == 0 &&
+           memcmp(&a.pid, &b.pid, sizeof(a.pid)) == 0 &&
+           a.command.orientation == b.command.orientation;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        cout << "Usage: " << argv[0] << " <config file> <video file> [telemetry log or -] [ldmap log or -] [output log]" << endl;
+        return 0;
+    }
+    string config_path(argv[1]);
+    string video_path(argv[2]);
+    string telemetry_path = argc > 3 ? argv[3] : "-";
+    string ldmap_path = argc > 4 ? argv[4] : "-";
+
+    double Kp = 0.0;
+    double Ki = 0.0;
+    double Kd = 0.0;
+    char tmp_path[] = "/tmp/replay_XXXXXX";
+    try
+    {
+        libconfig::Config cfg;
+        cfg.readFile(config_path.c_str());
+        if (cfg.exists("detector.pid_gains"))
+        {
+            Kp = cfg.lookup("detector.pid_gains.Kp");
+            Ki = cfg.lookup("detector.pid_gains.Ki");
+            Kd = cfg.lookup("detector.pid_gains.Kd");
+        }
+
+        // A replay must not overwrite the recordings it reads
+        if (cfg.exists("record")) cfg.getRoot().remove("record");
+        int fd = mkstemp(tmp_path);
+        if (fd < 0)
+        {
+            cerr << "Could not create temporary config file" << endl;
+            return 1;
+        }
+        close(fd);
+        cfg.writeFile(tmp_path);
+    }
+    catch(...)
+    {
+        cerr << "Invalid config file" << endl;
+        return 1;
+    }
+
+    unique_ptr<TelemetryReader> recorded;
+    if (telemetry_path != "-")
+    {
+        recorded.reset(new TelemetryReader(telemetry_path));
+        if (!recorded->isOpen()) return 1;
+    }
+    unique_ptr<LDMapReader> ldmaps;
+    if (ldmap_path != "-")
+    {
+        ldmaps.reset(new LDMapReader(ldmap_path));
+        if (!ldmaps->isOpen()) return 1;
+    }
+    TelemetryLog output;
+    if (argc > 5 && !output.open(argv[5], recorded ? recorded->size() : 1000000)) return 1;
+
+    VideoCapture cap(video_path);
+    if (!cap.isOpened())
+    {
+        cerr << "Could not open " << video_path << endl;
+        return 1;
+    }
+
+    // Decoding is timed separately so the reported speed is the pipeline's
+    double decode_s = 0;
+    Detector detector(tmp_path, [&cap, &decode_s]() {
+        auto begin = std::chrono::steady_clock::now();
+        Mat frame;
+        cap >> frame;
+        decode_s += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        return frame;
+    });
+    unlink(tmp_path);
+
+    PID pid(TIMEOUT / 1000.0, 10.0, -10.0, Kp, Kd, Ki);
+    const int64_t period_ns = TIMEOUT * 1000000LL;
+
+    uint64_t hash = FNV_OFFSET;
+    uint64_t frames = 0;
+    uint64_t matches = 0;
+    uint64_t next_ldmap = 0;
+    int64_t first_ns = 0;
+    int64_t last_ns = 0;
+    int64_t last_steady_ns = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    while (!recorded || frames < recorded->size())
+    {
+        int64_t now_ns = recorded ? (*recorded)[frames].time_ns : (int64_t)frames * period_ns;
+        int64_t steady_ns = recorded ? (*recorded)[frames].steady_ns : (int64_t)(frames + 1) * period_ns;
+
+        // Everything the vehicle reported before this frame. detect does not
+        // act on LDMaps yet; a handler added to its serial callback goes here.
+        while (ldmaps && next_ldmap < ldmaps->size() && (*ldmaps)[next_ldmap].time_ns <= now_ns)
+        {
+            next_ldmap++;
+        }
+
+        if (!detector.step()) break;
+
+        // Same control computation as detect
+        const Lane &lane = detector.getLane();
+        double radius = detector.getTurningRadius();
+        double dt = PID::interval(last_steady_ns, steady_ns, TIMEOUT / 1000.0);
+        double angle = pid.calculate(0.0, 1 / radius, dt);
+        UARTCommand command {
+            .maxTime = TIMEOUT,
+            .speed = 10,
+            .orientation = (int16_t)angle,
+            .distance = 200,
+            .dir = 1
+        };
+
+        TelemetryRecord record;
+        memset(&record, 0, sizeof(record));
+        Detector::Hits hits = detector.getHits();
+        Detector::SearchStats search = detector.getSearchStats();
+        record.frame = frames;
+        record.time_ns = now_ns;
+        record.steady_ns = steady_ns;
+        record.degree = lane.getDegree();
+        record.hits_left = hits.left;
+        record.hits_right = hits.right;
+        record.window_left = search.left.threshold;
+        record.window_right = search.right.threshold;
+        record.pixel_reads = search.reads;
+        record.confidence_left = search.confidence_left;
+        record.confidence_right = search.confidence_right;
+        std::copy(lane.getLParams(), lane.getLParams() + LANE_MAX_DEGREE, record.left);
+        std::copy(lane.getRParams(), lane.getRParams() + LANE_MAX_DEGREE, record.right);
+        std::copy(lane.getParams(), lane.getParams() + LANE_MAX_DEGREE, record.center);
+        record.radius = radius;
+        record.pid = angle;
+        record.command = command;
+
+        fnv1a(hash, record.left, sizeof(record.left));
+        fnv1a(hash, record.right, sizeof(record.right));
+        fnv1a(hash, record.center, sizeof(record.center));
+        fnv1a(hash, &record.radius, sizeof(record.radius));
+        fnv1a(hash, &record.pid, sizeof(record.pid));
+        fnv1a(hash, &command.orientation, sizeof(command.orientation));
+
+        if (recorded && same_output(record, (*recorded)[frames])) matches++;
+
+        TelemetryRecord *out = output.next();
+        if (out != nullptr)
+        {
+            *out = record;
+            output.commit();
+        }
+
+        if (frames == 0) first_ns = now_ns;
+        last_ns = now_ns;
+        last_steady_ns = steady_ns;
+        frames++;
+    }
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    double simulated_s = frames > 1 ? (last_ns - first_ns) / 1e9 : 0;
+
+    if (recorded && frames < recorded->size())
+    {
+        cerr << "Video ended after " << frames << " of " << recorded->size() << " recorded frames" << endl;
+    }
+
+    cout << "frames: " << frames << endl;
+    cout << "ldmaps: " << next_ldmap << endl;
+    cout << "simulated: " << simulated_s << " s" << endl;
+    cout << "wall: " << wall_s << " s (" << decode_s << " s decoding)" << endl;
+    cout << "frames/s: " << frames / wall_s << endl;
+    if (wall_s > 0) cout << "speedup: " << simulated_s / wall_s << "x" << endl;
+    if (recorded) cout << "matches recording: " << matches << "/" << frames << endl;
+    cout << "hash: " << hash_hex(hash) << endl;
+
+}
@@ -0,0 +1,25 @@
+#include "rlsfit.h"
+
+/**
+ * Creates the recursive least-squares estimator for a lane polynomial.
+ * @param degree number of coefficients (lane.n), 1 to 8
+ * @param height height of the birdseye image
+ * @param row_step stride between scanned rows
+ * @param forgetting weight of the previous frame (lane.forgetting), clamped to (0, 1]
+ * @return new fitter, owned by the caller
+ */
+LaneFitter *LaneFitter::createRecursive(int degree, int height, int row_step, double forgetting)
+{
+    forgetting = std::fmin(std::fmax(forgetting, 1e-3), 1.0);
+    switch (degree)
+    {
+        case 1: return new RecursiveFitter<1>(height, row_step, forgetting);
+        case 2: return new RecursiveFitter<2>(height, row_step, forgetting);
+        case 3: return new RecursiveFitter<3>(height, row_step, forgetting);
+        case 4: return new RecursiveFitter<4>(height, row_step, forgetting);
+        case 5: return new RecursiveFitter<5>(height, row_step, forgetting);
+        case 6: return new RecursiveFitter<6>(height, row_step, forgetting);
+        case 7: return new RecursiveFitter<7>(height, row_step, forgetting);
+        default: return new RecursiveFitter<8>(height, row_step, forgetting);
+    }
+}
@@ -0,0 +1,178 @@
+/**
+ * Provides a recursive least-squares lane estimator.
+ */
+
+#ifndef RLSFIT_H
+#define RLSFIT_H
+
+#include "fixedfit.h"
+
+#include <cmath>
+#include <vector>
+
+#define RLS_PRIOR 1e6 // initial variance of each coefficient, px^2: next to nothing is known
+
+/**
+ * Lane line estimated by recursive least squares with a forgetting factor.
+ *
+ * Unlike FixedFitter, the estimate carries over from frame to frame: every
+ * hit updates the coefficients and their covariance P in O(N^2), in the same
+ * scaled variable t = (y - h/2) / (h/2), and reset() ends a frame by dividing
+ * P by the forgetting factor, so a frame k frames back weighs forgetting^k.
+ * A frame with many hits moves the estimate more than a frame with few, and
+ * P, scaled by the noise variance of the hits, gives the uncertainty of the
+ * fitted line. While a line has no hits P stops growing once it is back at
+ * the prior, so the line is not lost to windup.
+ *
+ * Slot 0, the bottom point Detector predicts from the current estimate, is
+ * counted as a hit but carries no information and is not used.
+ */
+template <int N>
+class RecursiveFitter : public LaneFitter
+{
+private:
+    double center;
+    double scale;
+    double forgetting;
+    std::vector<double> powers; // N powers of t per grid slot
+
+    double theta[N];  // coefficients of powers of t
+    double P[N][N];   // covariance of theta, divided by the noise variance
+    double weight;    // forgetting-weighted number of hits
+    double residuals; // forgetting-weighted sum of squared residuals
+    int count;        // hits in the current frame
+
+    void update(const double *phi, double x)
+    {
+        // Gain k = P phi / (1 + phi' P phi); P -= k (P phi)'
+        double Pphi[N];
+        double denom = 1;
+        for (int j = 0; j < N; j++)
+        {
+            Pphi[j] = 0;
+            for (int k = 0; k < N; k++) Pphi[j] += P[j][k] * phi[k];
+            denom += phi[j] * Pphi[j];
+        }
+        double error = x;
+        for (int j = 0; j < N; j++) error -= phi[j] * theta[j];
+
+        for (int j = 0; j < N; j++)
+        {
+            theta[j] += Pphi[j] * error / denom;
+            for (int k = 0; k < N; k++) P[j][k] -= Pphi[j] * Pphi[k] / denom;
+        }
+
+        // Residual after the update: error scaled by 1 / denom
+        weight += 1;
+        residuals += error * error / (denom * denom);
+    }
+
+    void scaled(double y, double *phi) const
+    {
+        double t = (y - center) / scale;
+        phi[0] = 1;
+        for (int k = 1; k < N; k++) phi[k] = phi[k - 1] * t;
+    }
+
+public:
+    /**
+     * @param height height of the birdseye image
+     * @param row_step stride between scanned rows
+     * @param forgetting weight of the previous frame, 0 to 1 (1 never forgets)
+     */
+    RecursiveFitter(int height, int row_step, double forgetting)
+        : center(height / 2.0), scale(height / 2.0), forgetting(forgetting),
+          weight(0), residuals(0), count(0)
+    {
+        int slots = row_step > 0 ? (height - 1) / row_step + 2 : 1;
+        powers.resize(slots * N);
+        for (int s = 0; s < slots; s++)
+        {
+            scaled(s == 0 ? height : height - 1 - (s - 1) * row_step, &powers[s * N]);
+        }
+        for (int j = 0; j < N; j++)
+        {
+            theta[j] = 0;
+            for (int k = 0; k < N; k++) P[j][k] = j == k ? RLS_PRIOR : 0;
+        }
+    }
+
+    /**
+     * Ends a frame: older hits lose weight and the hit count starts over
+     */
+    void reset() override
+    {
+        double trace = 0;
+        for (int j = 0; j < N; j++) trace += P[j][j];
+        if (trace / forgetting <= N * RLS_PRIOR)
+        {
+            for (int j = 0; j < N; j++)
+            {
+                for (int k = 0; k < N; k++) P[j][k] /= forgetting;
+            }
+        }
+        weight *= forgetting;
+        residuals *= forgetting;
+        count = 0;
+    }
+
+    /**
+     * Adds a hit on a grid row
+     * @param slot grid slot of the row (see LaneFitter)
+     * @param x column of the hit
+     */
+    void add(int slot, double x) override
+    {
+        count++;
+        if (slot > 0) update(&powers[slot * N], x);
+    }
+
+    /**
+     * Adds a hit on an arbitrary row
+     * @param y row of the hit
+     * @param x column of the hit
+     */
+    void add(double y, double x) override
+    {
+        double phi[N];
+        scaled(y, phi);
+        count++;
+        update(phi, x);
+    }
+
+    int getCount() const override { return count; }
+
+    /**
+     * Every hit already moved the estimate when it was added, so holding a
+     * frame with few hits back would only make the lane jump on the next
+     * one. The estimate is used once it rests on more hits than it has
+     * coefficients, whatever this frame contributed.
+     */
+    bool isReady() const override { return weight > N; }
+
+    /**
+     * Gets the current estimate, which already includes every hit added
+     * @param store array of size N receiving the coefficients of powers of y
+     * @return true
+     */
+    bool solve(double *store) const override
+    {
+        unscale(theta, N, center, scale, store);
+        return true;
+    }
+
+    double uncertainty(double y) const override
+    {
+        if (weight <= N) return -1;
+        double phi[N];
+        scaled(y, phi);
+        double variance = 0;
+        for (int j = 0; j < N; j++)
+        {
+            for (int k = 0; k < N; k++) variance += phi[j] * P[j][k] * phi[k];
+        }
+        return std::sqrt(variance * residuals / (weight - N));
+    }
+};
+
+#endif
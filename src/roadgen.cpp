@@ -0,0 +1,159 @@
+#include "roadgen.h"
+#include "detector.h"
+#include "polynomial.h"
+
+#include <libconfig.h++>
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+
+#define ASPHALT 60           // gray level of the road surface
+#define PAINT 230            // gray level of the lane lines
+#define OCCLUSION_SEGMENTS 12 // pieces each line is split into for occlusion
+
+/**
+ * @param params road geometry, image size and noise
+ * @param angle camera.angle
+ * @param floor camera.frame.floor
+ * @param ceiling camera.frame.ceiling
+ */
+RoadGenerator::RoadGenerator(const Params &params, double angle, double floor, double ceiling)
+    : params(params)
+{
+    init(angle, floor, ceiling);
+}
+
+/**
+ * Reads the camera model from a config file
+ * @param config_path path to config file
+ * @param params road geometry, image size and noise
+ */
+RoadGenerator::RoadGenerator(std::string config_path, const Params &params)
+    : params(params)
+{
+    double angle = 0.239;
+    double floor = 0.847;
+    double ceiling = 0.188;
+
+    libconfig::Config cfg;
+    try
+    {
+        cfg.readFile(config_path.c_str());
+        angle = cfg.lookup("camera.angle");
+        floor = cfg.lookup("camera.frame.floor");
+        ceiling = cfg.lookup("camera.frame.ceiling");
+    }
+    catch(...)
+    {
+        std::cerr << "Invalid config file" << std::endl;
+    }
+    init(angle, floor, ceiling);
+}
+
+/**
+ * Builds the projection and expands the lane description into coefficients.
+ * With s = (height - y) / height running from 0 at the bottom to 1 at the top,
+ * the center is width * (center + heading * s + curvature * s^2).
+ */
+void RoadGenerator::init(double angle, double floor, double ceiling)
+{
+    const double w = params.width;
+    const double h = params.height;
+    fiperson = Detector::getTransformMatrix(params.height, params.width, angle, floor, ceiling, true);
+
+    double center[ROAD_DEGREE] = {
+        w * (params.center + params.heading + params.curvature),
+        -w * (params.heading + 2 * params.curvature) / h,
+        w * params.curvature / (h * h)
+    };
+    for (int i = 0; i < ROAD_DEGREE; i++)
+    {
+        left[i] = center[i];
+        right[i] = center[i];
+    }
+    left[0] -= w * params.lane_width / 2;
+    right[0] += w * params.lane_width / 2;
+
+    birdseye.create(params.height, params.width, CV_8UC3);
+}
+
+/**
+ * Renders one frame
+ * @param index frame number, selects the noise and occlusion pattern
+ * @param frame destination, reused if it already has the right size
+ */
+void RoadGenerator::render(int index, cv::Mat &frame)
+{
+    cv::RNG rng(params.seed * 1000003 + index);
+    birdseye.setTo(cv::Scalar::all(ASPHALT));
+
+    int thickness = std::max(1, (int)(params.line_width * params.width));
+    int row_step = std::max(1, params.height / 240);
+    int segment = params.height / OCCLUSION_SEGMENTS + 1;
+
+    std::vector<cv::Point> points;
+    for (const double *line : {left, right})
+    {
+        for (int begin = params.height; begin > 0; begin -= segment)
+        {
+            bool hidden = rng.uniform(0.0, 1.0) < params.occlusion;
+            if (hidden) continue;
+
+            points.clear();
+            int end = std::max(0, begin - segment);
+            for (int y = begin; y > end; y -= row_step)
+            {
+                points.push_back(cv::Point(polynomial(line, ROAD_DEGREE, y), y));
+            }
+            points.push_back(cv::Point(polynomial(line, ROAD_DEGREE, end), end));
+            cv::polylines(birdseye, points, false, cv::Scalar::all(PAINT), thickness);
+        }
+    }
+
+    cv::warpPerspective(birdseye, frame, fiperson, cv::Size(params.width, params.height),
+            cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar::all(ASPHALT));
+
+    if (params.noise > 0)
+    {
+        noise.create(params.height, params.width, CV_16SC3);
+        rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(params.noise));
+        cv::add(frame, noise, frame, cv::Mat(), CV_8U);
+    }
+}
+
+cv::Mat RoadGenerator::render(int index)
+{
+    cv::Mat frame;
+    render(index, frame);
+    return frame;
+}
+
+const RoadGenerator::Params& RoadGenerator::getParams() const { return params; }
+int RoadGenerator::getDegree() const { return ROAD_DEGREE; }
+const double *RoadGenerator::getLeft() const { return left; }
+const double *RoadGenerator::getRight() const { return right; }
+
+/**
+ * Applies a "name=value" command line setting, e.g. "curvature=0.2"
+ * @return false if the name is unknown or the value is missing
+ */
+bool RoadGenerator::parse(Params &params, const std::string &assignment)
+{
+    size_t eq = assignment.find('=');
+    if (eq == std::string::npos) return false;
+    std::string name = assignment.substr(0, eq);
+    const char *value = assignment.c_str() + eq + 1;
+
+    if (name == "width") params.width = atoi(value);
+    else if (name == "height") params.height = atoi(value);
+    else if (name == "center") params.center = atof(value);
+    else if (name == "lane_width") params.lane_width = atof(value);
+    else if (name == "heading") params.heading = atof(value);
+    else if (name == "curvature") params.curvature = atof(value);
+    else if (name == "line_width") params.line_width = atof(value);
+    else if (name == "noise") params.noise = atof(value);
+    else if (name == "occlusion") params.occlusion = atof(value);
+    else if (name == "seed") params.seed = strtoull(value, nullptr, 10);
+    else return false;
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef ROADGEN_H
+#define ROADGEN_H
+
+#include "opencv2/opencv.hpp"
+
+#include <string>
+#include <cstdint>
+
+#define ROAD_DEGREE 3 // coefficients of the ground truth lane curves (quadratic)
+
+/**
+ * Renders deterministic first-person road frames with known lane geometry.
+ *
+ * Both lane lines are quadratics in birdseye pixel coordinates, the same
+ * space Detector fits in. They are drawn on a birdseye canvas and projected
+ * into the camera image with the inverse of Detector::getTransformMatrix, so
+ * the coefficients returned by getLeft()/getRight() are exactly what a
+ * perfect detector would report in Lane::getLParams()/getRParams().
+ *
+ * The same seed and frame index always give the same image.
+ */
+class RoadGenerator
+{
+public:
+    struct Params
+    {
+        int width = 640;
+        int height = 480;
+        double center = 0.5;      // lane center at the bottom of the birdseye image, fraction of width
+        double lane_width = 0.1;  // distance between the lines, fraction of width
+        double heading = 0.0;     // lateral drift of the lane center over the whole image, fraction of width
+        double curvature = 0.0;   // additional quadratic drift over the whole image, fraction of width
+        double line_width = 0.01; // painted line thickness, fraction of width
+        double noise = 12.0;      // standard deviation of per-pixel gaussian noise, in gray levels
+        double occlusion = 0.0;   // probability that a line segment is hidden (worn paint, shadows, cars)
+        uint64_t seed = 12345;
+    };
+
+    RoadGenerator(const Params &params, double angle, double floor, double ceiling);
+    RoadGenerator(std::string config_path, const Params &params);
+
+    void render(int index, cv::Mat &frame);
+    cv::Mat render(int index = 0);
+
+    const Params& getParams() const;
+    int getDegree() const;
+    const double *getLeft() const;
+    const double *getRight() const;
+
+    static bool parse(Params &params, const std::string &assignment);
+
+private:
+    Params params;
+    cv::Mat fiperson; // birdseye -> camera perspective
+    double left[ROAD_DEGREE];
+    double right[ROAD_DEGREE];
+
+    cv::Mat birdseye;
+    cv::Mat noise;
+
+    void init(double angle, double floor, double ceiling);
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Cycles with at least half a period of slack needed before DEGRADE steps back up
+#define CALM_CYCLES 10
+
+/**
+ * @param freq_hz loop rate
+ * @param policy what to do when a cycle overruns its period
+ * @param max_level highest degradation level DEGRADE will request
+ */
+RateScheduler::RateScheduler(double freq_hz, Policy policy, int max_level)
+    : period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / freq_hz))),
+      policy(policy), max_level(max_level)
+{
+}
+
+/**
+ * Releases the first cycle now. Call once before the loop.
+ */
+void RateScheduler::start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    release = Clock::now();
+    last_start = release;
+}
+
+/**
+ * Ends the running cycle and returns when the next one should start.
+ */
+void RateScheduler::wait()
+{
+    Clock::time_point now = Clock::now();
+    Clock::time_point next;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cycles++;
+        next = release + period;
+
+        if (now <= next)
+        {
+            if (next - now >= period / 2)
+            {
+                if (++calm >= CALM_CYCLES && level > 0)
+                {
+                    level--;
+                    calm = 0;
+                }
+            }
+            else
+            {
+                calm = 0;
+            }
+        }
+        else
+        {
+            overruns++;
+            calm = 0;
+            if (policy != LATE)
+            {
+                // Continue from the most recent release instead of catching up
+                uint64_t missed = (now - next) / period;
+                next += missed * period;
+                skipped += missed;
+            }
+            if (policy == DEGRADE && level < max_level)
+            {
+                level++;
+            }
+        }
+        release = next;
+    }
+
+    std::this_thread::sleep_until(next);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    begin(Clock::now());
+}
+
+/**
+ * Records the start of a cycle. Caller holds the mutex.
+ */
+void RateScheduler::begin(Clock::time_point now)
+{
+    double actual = std::chrono::duration<double>(now - last_start).count();
+    double late = std::chrono::duration<double>(now - release).count();
+    last_start = now;
+
+    // cycles already counts the cycle that just ended
+    double delta = actual - mean;
+    mean += delta / cycles;
+    m2 += delta * (actual - mean);
+    max_late = std::max(max_late, late);
+}
+
+int RateScheduler::getLevel() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return level;
+}
+
+RateScheduler::Stats RateScheduler::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats;
+    stats.target_ms = std::chrono::duration<double, std::milli>(period).count();
+    stats.cycles = cycles;
+    stats.overruns = overruns;
+    stats.skipped = skipped;
+    stats.period_ms = mean * 1000;
+    stats.jitter_ms = cycles > 1 ? std::sqrt(m2 / (cycles - 1)) * 1000 : 0;
+    stats.max_late_ms = max_late * 1000;
+    stats.level = level;
+    return stats;
+}
+
+/**
+ * @param name "late", "skip" or "degrade"
+ * @return matching policy, SKIP if the name is unknown
+ */
+RateScheduler::Policy RateScheduler::parsePolicy(const std::string &name)
+{
+    if (name == "late") return LATE;
+    if (name == "degrade") return DEGRADE;
+    return SKIP;
+}
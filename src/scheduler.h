@@ -0,0 +1,71 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * Paces a loop at a fixed rate using absolute release times.
+ *
+ * Cycle k is released at start + k * period, independent of how long earlier
+ * cycles took, so the loop rate does not drift. A cycle that ends after the
+ * next release time is an overrun, handled according to the policy:
+ *   LATE    run the missed cycles back to back until the loop catches up
+ *   SKIP    drop the missed releases and continue on the next one
+ *   DEGRADE like SKIP, and raise the degradation level so the caller can do
+ *           less work; the level drops again after a run of cycles with slack
+ */
+class RateScheduler
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum Policy { LATE, SKIP, DEGRADE };
+
+    struct Stats
+    {
+        double target_ms;   // configured period
+        uint64_t cycles;    // completed cycles
+        uint64_t overruns;  // cycles that finished after the next release time
+        uint64_t skipped;   // release times dropped by SKIP / DEGRADE
+        double period_ms;   // mean time between cycle starts
+        double jitter_ms;   // standard deviation of the time between cycle starts
+        double max_late_ms; // largest delay of a cycle start after its release time
+        int level;          // current degradation level
+    };
+
+    RateScheduler(double freq_hz, Policy policy = SKIP, int max_level = 2);
+
+    void start();
+    void wait();
+
+    int getLevel() const;
+    Stats getStats() const;
+
+    static Policy parsePolicy(const std::string &name);
+
+private:
+    void begin(Clock::time_point now);
+
+    Clock::duration period;
+    Policy policy;
+    int max_level;
+
+    Clock::time_point release;    // release time of the running cycle
+    Clock::time_point last_start; // when the running cycle actually started
+    int level = 0;
+    int calm = 0;                 // consecutive cycles with at least half a period of slack
+
+    uint64_t cycles = 0;
+    uint64_t overruns = 0;
+    uint64_t skipped = 0;
+    double mean = 0;              // running mean of the start-to-start period, seconds
+    double m2 = 0;                // running sum of squared deviations (Welford)
+    double max_late = 0;
+
+    mutable std::mutex mutex;
+};
+
+#endif
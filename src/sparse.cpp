@@ -0,0 +1,80 @@
+#include "sparse.h"
+
+#include <cmath>
+
+using namespace cv;
+
+/**
+ * @param fiperson perspective transform from birdseye to first-person view
+ * @param width width of the camera frame and birdseye view
+ * @param height height of the camera frame and birdseye view
+ * @param threshold binary threshold applied to the blurred grayscale value
+ */
+SparseSampler::SparseSampler(const cv::Mat &fiperson, int width, int height, int threshold)
+    : width(width), height(height), threshold(threshold)
+{
+    Mat m;
+    fiperson.convertTo(m, CV_64F);
+    for (int i = 0; i < 9; i++)
+    {
+        h[i] = m.at<double>(i / 3, i % 3);
+    }
+
+    // Same kernel as GaussianBlur(Size(7, 7), 1.5, 1.5) in thresh()
+    Mat k = getGaussianKernel(7, 1.5, CV_64F);
+    for (int i = 0; i < 7; i++)
+    {
+        kernel[i] = (float)k.at<double>(i);
+    }
+}
+
+/**
+ * Sets the camera frame probed by subsequent calls. The frame is not copied
+ * and must outlive the probes.
+ * @param frame BGR camera frame
+ */
+void SparseSampler::setFrame(const cv::Mat &frame)
+{
+    this->frame = &frame;
+}
+
+/**
+ * Reflects an out of range index back into [0, n), like BORDER_REFLECT_101
+ */
+int SparseSampler::index(int i, int n) const
+{
+    if (i < 0) return -i;
+    if (i >= n) return 2 * n - 2 - i;
+    return i;
+}
+
+/**
+ * Classifies one pixel of the (virtual) thresholded birdseye image.
+ * @param row birdseye row
+ * @param col birdseye column
+ * @return true if the pixel would be 255 in the thresholded birdseye image
+ */
+bool SparseSampler::probe(int row, int col) const
+{
+    if (col < 0 || col >= width || row < 0 || row >= height) return false;
+
+    double w = h[6] * col + h[7] * row + h[8];
+    if (w == 0) return false;
+    int u = (int)std::floor((h[0] * col + h[1] * row + h[2]) / w + 0.5);
+    int v = (int)std::floor((h[3] * col + h[4] * row + h[5]) / w + 0.5);
+    if (u < 0 || u >= frame->cols || v < 0 || v >= frame->rows) return false;
+
+    float sum = 0;
+    for (int dy = -3; dy <= 3; dy++)
+    {
+        const Vec3b *line = frame->ptr<Vec3b>(index(v + dy, frame->rows));
+        float row_sum = 0;
+        for (int dx = -3; dx <= 3; dx++)
+        {
+            const Vec3b &px = line[index(u + dx, frame->cols)];
+            row_sum += kernel[dx + 3] * (0.114f * px[0] + 0.587f * px[1] + 0.299f * px[2]);
+        }
+        sum += kernel[dy + 3] * row_sum;
+    }
+    return sum > threshold;
+}
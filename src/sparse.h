@@ -0,0 +1,36 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "opencv2/opencv.hpp"
+
+/**
+ * Classifies individual birdseye pixels straight from the camera frame.
+ *
+ * Each probe maps a birdseye (row, col) back through the first-person
+ * homography and evaluates grayscale, the 7x7 gaussian blur and the threshold
+ * of thresh() on that one camera pixel only. Used by Detector in sparse mode,
+ * where the search windows are the only pixels ever looked at, so the full
+ * birdseye image is never built. probe() keeps no state, so several threads
+ * may probe the same frame at once.
+ */
+class SparseSampler
+{
+private:
+    int width;
+    int height;
+    int threshold;
+    double h[9];       // birdseye -> first-person homography, row major
+    float kernel[7];   // 1D gaussian weights, applied separably
+
+    const cv::Mat *frame = nullptr;
+
+    int index(int i, int n) const;
+
+public:
+    SparseSampler(const cv::Mat &fiperson, int width, int height, int threshold);
+
+    void setFrame(const cv::Mat &frame);
+    bool probe(int row, int col) const;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Bounded single-producer single-consumer queue.
+ *
+ * All slots are allocated in the constructor. push() and pop() never block
+ * and never allocate; they fail instead when the queue is full or empty.
+ * Exactly one thread may push and exactly one (other) thread may pop.
+ */
+template <typename T>
+class SpscQueue
+{
+private:
+    std::vector<T> slots;
+    size_t capacity;
+
+    // Padded apart so producer and consumer do not share a cache line. Padding
+    // instead of alignas keeps the queue usable as a member of heap objects
+    // without over-aligned new.
+    char pad0[64];
+    std::atomic<size_t> head; // next slot to pop
+    char pad1[64];
+    std::atomic<size_t> tail; // next slot to push
+    char pad2[64];
+
+public:
+    SpscQueue(size_t capacity)
+        : slots(capacity + 1), capacity(capacity + 1), head(0), tail(0) {}
+
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = t + 1 == capacity ? 0 : t + 1;
+        if (next == head.load(std::memory_order_acquire)) return false;
+        slots[t] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = slots[h];
+        head.store(h + 1 == capacity ? 0 : h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @return number of queued items; exact only when called by the producer or consumer
+     */
+    size_t size() const
+    {
+        size_t h = head.load(std::memory_order_acquire);
+        size_t t = tail.load(std::memory_order_acquire);
+        return t >= h ? t - h : t + capacity - h;
+    }
+
+    bool empty() const { return size() == 0; }
+};
+
+#endif
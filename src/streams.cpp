@@ -0,0 +1,174 @@
+#include "streams.h"
+
+#include <algorithm>
+
+/**
+ * @param workers number of worker threads shared by all streams
+ */
+StreamEngine::StreamEngine(int workers)
+    : workers(workers < 1 ? 1 : workers)
+{
+}
+
+StreamEngine::~StreamEngine()
+{
+    stop();
+}
+
+/**
+ * Registers a stream. Must be called before start().
+ * @param detector detector owning the stream's state; not owned by the engine
+ * @param callback called on a worker thread after each detection cycle
+ * @param freq_hz target rate of the stream, or 0 to run it as often as possible
+ * @return stream id used by getStats()
+ */
+int StreamEngine::addStream(Detector *detector, std::function<void(const Lane &lane)> callback, double freq_hz)
+{
+    Stream stream;
+    stream.detector = detector;
+    stream.callback = callback;
+    stream.period = freq_hz > 0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / freq_hz))
+        : Clock::duration::zero();
+    stream.finished = false;
+    stream.frames = 0;
+    stream.busy = Clock::duration::zero();
+    stream.max_wait = Clock::duration::zero();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    streams.push_back(stream);
+    return streams.size() - 1;
+}
+
+void StreamEngine::start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!threads.empty()) return;
+
+    started = Clock::now();
+    stopping = false;
+    running_streams = streams.size();
+    ready.clear();
+    for (int i = 0; i < (int)streams.size(); i++)
+    {
+        streams[i].due = started;
+        ready.push_back(i);
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        threads.push_back(std::thread(&StreamEngine::work, this));
+    }
+}
+
+/**
+ * Stops scheduling new cycles and waits for the running ones to finish
+ */
+void StreamEngine::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stopping && running_streams > 0) stopped = Clock::now();
+        stopping = true;
+    }
+    wake.notify_all();
+    join();
+}
+
+/**
+ * Waits until every stream has run out of frames (or stop() was called)
+ */
+void StreamEngine::join()
+{
+    for (std::thread &thread : threads)
+    {
+        if (thread.joinable()) thread.join();
+    }
+    threads.clear();
+}
+
+void StreamEngine::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping && running_streams > 0)
+    {
+        // First due stream in FIFO order
+        Clock::time_point now = Clock::now();
+        Clock::time_point earliest = Clock::time_point::max();
+        auto next = ready.begin();
+        for (; next != ready.end(); ++next)
+        {
+            if (streams[*next].due <= now) break;
+            earliest = std::min(earliest, streams[*next].due);
+        }
+
+        if (next == ready.end())
+        {
+            if (ready.empty()) wake.wait(lock);
+            else wake.wait_until(lock, earliest);
+            continue;
+        }
+
+        int id = *next;
+        ready.erase(next);
+        Stream &stream = streams[id];
+        stream.max_wait = std::max(stream.max_wait, now - stream.due);
+        lock.unlock();
+
+        Clock::time_point begin = Clock::now();
+        bool ok = stream.detector->step();
+        if (ok && stream.callback) stream.callback(stream.detector->getLane());
+        Clock::time_point end = Clock::now();
+
+        lock.lock();
+        if (!ok)
+        {
+            stream.finished = true;
+            if (--running_streams == 0)
+            {
+                stopped = end;
+                wake.notify_all();
+            }
+            continue;
+        }
+
+        stream.frames++;
+        stream.busy += end - begin;
+        stream.due = stream.period == Clock::duration::zero() ? end : stream.due + stream.period;
+        ready.push_back(id);
+        wake.notify_one();
+    }
+}
+
+int StreamEngine::getStreamCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return streams.size();
+}
+
+StreamEngine::Stats StreamEngine::getStats(int id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const Stream &stream = streams[id];
+    Clock::time_point end = stopping || running_streams == 0 ? stopped : Clock::now();
+    double elapsed = std::chrono::duration<double>(end - started).count();
+
+    Stats stats;
+    stats.frames = stream.frames;
+    stats.busy_ms = std::chrono::duration<double, std::milli>(stream.busy).count();
+    stats.max_wait_ms = std::chrono::duration<double, std::milli>(stream.max_wait).count();
+    stats.fps = elapsed > 0 ? stream.frames / elapsed : 0;
+    return stats;
+}
+
+/**
+ * @return frames per second completed across all streams
+ */
+double StreamEngine::getThroughput() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Clock::time_point end = stopping || running_streams == 0 ? stopped : Clock::now();
+    double elapsed = std::chrono::duration<double>(end - started).count();
+    uint64_t frames = 0;
+    for (const Stream &stream : streams) frames += stream.frames;
+    return elapsed > 0 ? frames / elapsed : 0;
+}
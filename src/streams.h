@@ -0,0 +1,79 @@
+#ifndef STREAMS_H
+#define STREAMS_H
+
+#include "detector.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs several independent Detectors on a fixed pool of worker threads.
+ *
+ * Streams wait in a single FIFO ready queue. A worker takes the first stream
+ * that is due, runs exactly one Detector::step() and its callback, and puts
+ * the stream back at the tail, so every due stream gets one frame per round
+ * regardless of how expensive the others are. A stream is never stepped by
+ * two workers at once, so each Detector still sees its frames in order.
+ */
+class StreamEngine
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Stats
+    {
+        uint64_t frames;    // completed detection cycles
+        double busy_ms;     // time spent in step() and the callback
+        double max_wait_ms; // longest time the stream was due but not running
+        double fps;         // frames per second since start()
+    };
+
+    StreamEngine(int workers);
+    virtual ~StreamEngine();
+
+    int addStream(Detector *detector, std::function<void(const Lane &lane)> callback, double freq_hz = 0);
+
+    void start();
+    void stop();
+    void join();
+
+    int getStreamCount() const;
+    Stats getStats(int stream) const;
+    double getThroughput() const;
+
+private:
+    struct Stream
+    {
+        Detector *detector;
+        std::function<void(const Lane &lane)> callback;
+        Clock::duration period; // zero runs the stream as often as possible
+        Clock::time_point due;
+        bool finished;
+
+        uint64_t frames;
+        Clock::duration busy;
+        Clock::duration max_wait;
+    };
+
+    void work();
+
+    int workers;
+    std::vector<Stream> streams;
+    std::deque<int> ready;
+    int running_streams = 0;
+    bool stopping = false;
+    Clock::time_point started;
+    Clock::time_point stopped;
+
+    std::vector<std::thread> threads;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+};
+
+#endif
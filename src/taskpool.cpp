@@ -0,0 +1,143 @@
+#include "taskpool.h"
+
+/**
+ * @param threads threads that run tasks, including the one calling
+ *        parallelFor(); 1 runs everything on the caller
+ */
+TaskPool::TaskPool(int threads)
+    : threads(threads > 0 ? threads : 1), queues(this->threads),
+      pending(0), running(true), batches(0), tasks(0), stolen(0)
+{
+    for (int i = 1; i < this->threads; i++)
+    {
+        workers.emplace_back(&TaskPool::work, this, i);
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        running = false;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * Runs task(0) ... task(count - 1) on the pool and waits for all of them.
+ * May be called from several threads at once.
+ * @param count number of tasks
+ * @param task called once per index, from any pool thread
+ */
+void TaskPool::parallelFor(int count, const std::function<void(int)> &task)
+{
+    if (count <= 0) return;
+    batches++;
+    if (threads == 1 || count == 1)
+    {
+        for (int i = 0; i < count; i++) task(i);
+        tasks += count;
+        return;
+    }
+
+    Batch batch;
+    batch.task = &task;
+    batch.remaining = count;
+    batch.finished = false;
+    for (int i = 0; i < count; i++)
+    {
+        Queue &queue = queues[i % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(Task{&batch, i});
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        pending += count;
+    }
+    wake.notify_all();
+
+    while (batch.remaining.load(std::memory_order_acquire) > 0)
+    {
+        if (!runOne(0)) break;
+    }
+
+    // Whatever is left is running on other threads. Waiting on the batch's
+    // own flag also keeps it alive until the last task is done with it.
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.done.wait(lock, [&batch]() { return batch.finished; });
+}
+
+int TaskPool::getThreads() const
+{
+    return threads;
+}
+
+TaskPool::Stats TaskPool::getStats() const
+{
+    return Stats{batches, tasks, stolen};
+}
+
+/**
+ * Worker loop: run tasks while there are any, sleep otherwise
+ */
+void TaskPool::work(int self)
+{
+    while (true)
+    {
+        if (runOne(self)) continue;
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait(lock, [this]() { return pending > 0 || !running; });
+        if (!running) return;
+    }
+}
+
+/**
+ * Takes a task from the back of the thread's own queue, or steals one from
+ * the front of another queue, and runs it
+ * @param self index of the calling thread's queue
+ * @return false if every queue was empty
+ */
+bool TaskPool::runOne(int self)
+{
+    Task task;
+    bool found = false;
+    bool own = true;
+    for (int k = 0; k < threads && !found; k++)
+    {
+        Queue &queue = queues[(self + k) % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (k == 0)
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            own = false;
+        }
+        found = true;
+    }
+    if (!found) return false;
+
+    pending--;
+    tasks++;
+    if (!own) stolen++;
+    Batch *batch = task.batch;
+    (*batch->task)(task.index);
+    if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        // Last access to the batch: the caller may return once it sees finished
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        batch->finished = true;
+        batch->done.notify_one();
+    }
+    return true;
+}
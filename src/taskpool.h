@@ -0,0 +1,80 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Persistent pool of worker threads for splitting one frame's work.
+ *
+ * parallelFor() deals the tasks of a batch round-robin onto one deque per
+ * thread, the calling thread included. Every thread works through its own
+ * deque from the back and, when it runs dry, steals from the front of the
+ * others, so uneven tasks (e.g. stripes with more lane pixels) balance out.
+ * The caller works too and, once nothing is left to take, sleeps until the
+ * last task of its batch has run. Workers sleep while there is nothing to do,
+ * so several callers waiting at once do not take CPU from the workers.
+ */
+class TaskPool
+{
+public:
+    struct Stats
+    {
+        uint64_t batches; // parallelFor() calls
+        uint64_t tasks;   // tasks run
+        uint64_t stolen;  // tasks run by a thread other than the one they were dealt to
+    };
+
+    TaskPool(int threads);
+    virtual ~TaskPool();
+
+    void parallelFor(int count, const std::function<void(int)> &task);
+    int getThreads() const;
+    Stats getStats() const;
+
+private:
+    struct Batch
+    {
+        const std::function<void(int)> *task;
+        std::atomic<int> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        bool finished; // set under mutex by the thread that ran the last task
+    };
+
+    struct Task
+    {
+        Batch *batch;
+        int index;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    int threads;
+    std::vector<Queue> queues; // queue 0 belongs to the calling thread
+    std::vector<std::thread> workers;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<int> pending; // tasks dealt but not yet taken
+    std::atomic<bool> running;
+
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> tasks;
+    std::atomic<uint64_t> stolen;
+
+    void work(int self);
+    bool runOne(int self);
+};
+
+#endif
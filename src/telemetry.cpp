@@ -0,0 +1,303 @@
+#include "telemetry.h"
+
+#include <libconfig.h++>
+#include <iostream>
+#include <cstring>
+#include <assert.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TELEMETRY_MAGIC "LANETLM"
+#define LDMAP_MAGIC "LANELDM"
+#define DEFAULT_CAPACITY 100000 // records, about 12 minutes at 120 fps
+
+//-----TELEMETRY LOG-----//
+
+/**
+ * Reads the telemetry section of a config file:
+ *   telemetry = { file = "telemetry.bin"; ldmap_file = "ldmap.bin"; capacity = 100000; };
+ * @param key name of the file setting
+ * @return path of the log, empty if there is no such setting
+ */
+static std::string log_path(const std::string &config_path, const char *key, int &capacity)
+{
+    std::string path;
+    capacity = DEFAULT_CAPACITY;
+    libconfig::Config cfg;
+    try
+    {
+        cfg.readFile(config_path.c_str());
+        if (!cfg.exists("telemetry")) return "";
+        cfg.lookupValue((std::string("telemetry.") + key).c_str(), path);
+        cfg.lookupValue("telemetry.capacity", capacity);
+    }
+    catch(...)
+    {
+        std::cerr << "Invalid config file" << std::endl;
+        return "";
+    }
+    if (capacity <= 0) capacity = DEFAULT_CAPACITY;
+    return path;
+}
+
+/**
+ * Creates a closed log, see open()
+ */
+TelemetryLog::TelemetryLog()
+    : MappedLog(TELEMETRY_MAGIC, sizeof(TelemetryRecord))
+{
+}
+
+/**
+ * Opens the log named by telemetry.file, or leaves it closed if there is none
+ * @param config_path path to config file
+ */
+TelemetryLog::TelemetryLog(std::string config_path)
+    : MappedLog(TELEMETRY_MAGIC, sizeof(TelemetryRecord))
+{
+    int capacity;
+    std::string path = log_path(config_path, "file", capacity);
+    if (!path.empty()) open(path, capacity);
+}
+
+/**
+ * Gets the record to fill for the next frame. It becomes part of the log
+ * when commit() is called. Call from one thread only.
+ * @return record with frame set, or nullptr if the log is closed or full
+ */
+TelemetryRecord *TelemetryLog::next()
+{
+    TelemetryRecord *record = (TelemetryRecord *)nextRecord();
+    if (record != nullptr) record->frame = size();
+    return record;
+}
+
+//-----LDMAP LOG-----//
+
+/**
+ * Opens the log named by telemetry.ldmap_file, or leaves it closed if there is none
+ * @param config_path path to config file
+ */
+LDMapLog::LDMapLog(std::string config_path)
+    : MappedLog(LDMAP_MAGIC, sizeof(LDMapRecord))
+{
+    int capacity;
+    std::string path = log_path(config_path, "ldmap_file", capacity);
+    if (!path.empty()) open(path, capacity);
+}
+
+/**
+ * Appends one LDMap. Call from one thread only.
+ * @param time_ns time it was received, same clock as TelemetryRecord::time_ns
+ */
+void LDMapLog::append(const LDMap &ldmap, int64_t time_ns)
+{
+    LDMapRecord *record = (LDMapRecord *)nextRecord();
+    if (record == nullptr) return;
+    record->time_ns = time_ns;
+    record->ldmap = ldmap;
+    commit();
+}
+
+//-----MAPPED LOG-----//
+
+/**
+ * @param magic file type, at most 7 characters
+ * @param record_size bytes per record
+ */
+MappedLog::MappedLog(const char *magic, uint32_t record_size)
+    : magic(magic), record_size(record_size)
+{
+    assert(strlen(magic) < sizeof(TelemetryHeader::magic));
+}
+
+MappedLog::~MappedLog()
+{
+    close();
+}
+
+/**
+ * Creates (or replaces) a log file with room for a number of records
+ * @return false if the file could not be created or mapped
+ */
+bool MappedLog::open(const std::string &path, uint64_t capacity)
+{
+    close();
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    mapped_size = sizeof(TelemetryHeader) + capacity * record_size;
+    if (fd < 0 || ftruncate(fd, mapped_size) != 0)
+    {
+        std::cerr << "Could not create log " << path << std::endl;
+        close();
+        return false;
+    }
+
+    void *map = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "Could not map log " << path << std::endl;
+        close();
+        return false;
+    }
+
+    header = (TelemetryHeader *)map;
+    records = (char *)(header + 1);
+    memset(header->magic, 0, sizeof(header->magic));
+    memcpy(header->magic, magic, strlen(magic));
+    header->version = TELEMETRY_VERSION;
+    header->record_size = record_size;
+    header->capacity = capacity;
+    header->count = 0;
+    dropped = 0;
+    return true;
+}
+
+/**
+ * Flushes the mapping and cuts the file down to the records written
+ */
+void MappedLog::close()
+{
+    if (header != nullptr)
+    {
+        uint64_t count = header->count;
+        munmap(header, mapped_size);
+        header = nullptr;
+        records = nullptr;
+        if (ftruncate(fd, sizeof(TelemetryHeader) + count * record_size) != 0)
+        {
+            std::cerr << "Could not truncate log" << std::endl;
+        }
+    }
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool MappedLog::isOpen() const
+{
+    return header != nullptr;
+}
+
+/**
+ * @return space for the next record, or nullptr if the log is closed or full
+ */
+void *MappedLog::nextRecord()
+{
+    if (header == nullptr) return nullptr;
+    uint64_t count = header->count;
+    if (count >= header->capacity)
+    {
+        dropped++;
+        return nullptr;
+    }
+    return records + count * record_size;
+}
+
+/**
+ * Appends the record returned by next()/nextRecord()
+ */
+void MappedLog::commit()
+{
+    if (header == nullptr || header->count >= header->capacity) return;
+    // Release so a concurrent reader never counts a half written record
+    __atomic_store_n(&header->count, header->count + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t MappedLog::size() const
+{
+    return header != nullptr ? header->count : 0;
+}
+
+/**
+ * @return records that did not fit into the file
+ */
+uint64_t MappedLog::getDropped() const
+{
+    return dropped;
+}
+
+//-----READERS-----//
+
+MappedLogReader::MappedLogReader(const std::string &path, const char *magic, uint32_t record_size)
+    : record_size(record_size)
+{
+    fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TelemetryHeader))
+    {
+        std::cerr << "Could not open log " << path << std::endl;
+        return;
+    }
+
+    mapped_size = st.st_size;
+    void *map = mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        std::cerr << "Could not map log " << path << std::endl;
+        return;
+    }
+
+    header = (const TelemetryHeader *)map;
+    if (strncmp(header->magic, magic, sizeof(header->magic)) != 0 ||
+        header->version != TELEMETRY_VERSION || header->record_size != record_size)
+    {
+        std::cerr << path << " is not a " << magic << " log of this version" << std::endl;
+        munmap((void *)header, mapped_size);
+        header = nullptr;
+        return;
+    }
+    records = (const char *)(header + 1);
+}
+
+MappedLogReader::~MappedLogReader()
+{
+    if (header != nullptr) munmap((void *)header, mapped_size);
+    if (fd >= 0) ::close(fd);
+}
+
+bool MappedLogReader::isOpen() const
+{
+    return header != nullptr;
+}
+
+/**
+ * @return complete records in the file
+ */
+uint64_t MappedLogReader::size() const
+{
+    if (header == nullptr) return 0;
+    uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+    uint64_t fits = (mapped_size - sizeof(TelemetryHeader)) / record_size;
+    return count < fits ? count : fits;
+}
+
+const void *MappedLogReader::at(uint64_t i) const
+{
+    return records + i * record_size;
+}
+
+TelemetryReader::TelemetryReader(const std::string &path)
+    : MappedLogReader(path, TELEMETRY_MAGIC, sizeof(TelemetryRecord))
+{
+}
+
+const TelemetryRecord& TelemetryReader::operator[](uint64_t i) const
+{
+    return *(const TelemetryRecord *)at(i);
+}
+
+LDMapReader::LDMapReader(const std::string &path)
+    : MappedLogReader(path, LDMAP_MAGIC, sizeof(LDMapRecord))
+{
+}
+
+const LDMapRecord& LDMapReader::operator[](uint64_t i) const
+{
+    return *(const LDMapRecord *)at(i);
+}
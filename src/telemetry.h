@@ -0,0 +1,157 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "lane.h"
+#include "uartcommander.h"
+
+#include <string>
+#include <cstdint>
+
+#define TELEMETRY_VERSION 3
+
+/**
+ * One detected frame. Fixed size and trivially copyable so the log is a
+ * plain array of these after the header.
+ */
+struct TelemetryRecord
+{
+    uint64_t frame;       // record number, from 0
+    int64_t time_ns;      // system clock when the lane was reported, ns since the epoch
+    int64_t steady_ns;    // steady clock at the same moment; the PID interval is measured on it
+    int32_t degree;       // coefficients in use in left, right and center
+    int32_t hits_left;    // search rows with a hit on the left line
+    int32_t hits_right;   // search rows with a hit on the right line
+    int32_t command_sent; // 1 if command was sent to the vehicle
+    int32_t window_left;  // columns searched on each side of the left line
+    int32_t window_right; // columns searched on each side of the right line
+    int32_t pixel_reads;  // pixels probed by the search
+    int32_t reserved;
+    double confidence_left;  // Detector::SearchStats
+    double confidence_right;
+    double left[LANE_MAX_DEGREE];
+    double right[LANE_MAX_DEGREE];
+    double center[LANE_MAX_DEGREE];
+    double radius;        // Detector::getTurningRadius()
+    double pid;           // PID output
+    UARTCommand command;
+};
+
+/**
+ * One LDMap received from the vehicle, stamped with the same clock as
+ * TelemetryRecord::time_ns so a run can be replayed in order.
+ */
+struct LDMapRecord
+{
+    int64_t time_ns;      // system clock when the LDMap was dispatched, ns since the epoch
+    LDMap ldmap;
+};
+
+struct TelemetryHeader
+{
+    char magic[8];        // "LANETLM" for TelemetryRecords, "LANELDM" for LDMapRecords
+    uint32_t version;     // TELEMETRY_VERSION
+    uint32_t record_size; // sizeof the record type of the writer
+    uint64_t capacity;    // records the file has room for
+    uint64_t count;       // records written; updated after each record
+};
+
+/**
+ * Append-only log of fixed size records in a preallocated, memory-mapped file.
+ *
+ * Appending is filling a record in place and bumping the count in the
+ * header, so it costs a few stores and no system call. When the file is full
+ * further records are dropped and counted. On close the file is truncated to
+ * the records written. Use TelemetryLog or LDMapLog.
+ */
+class MappedLog
+{
+public:
+    MappedLog(const char *magic, uint32_t record_size);
+    virtual ~MappedLog();
+
+    bool open(const std::string &path, uint64_t capacity);
+    void close();
+    bool isOpen() const;
+
+    void commit();
+
+    uint64_t size() const;
+    uint64_t getDropped() const;
+
+protected:
+    void *nextRecord();
+
+private:
+    const char *magic;
+    uint32_t record_size;
+    int fd = -1;
+    size_t mapped_size = 0;
+    TelemetryHeader *header = nullptr;
+    char *records = nullptr;
+    uint64_t dropped = 0;
+};
+
+/**
+ * Per-frame log, enabled by telemetry.file in the config file
+ */
+class TelemetryLog : public MappedLog
+{
+public:
+    TelemetryLog();
+    TelemetryLog(std::string config_path);
+
+    TelemetryRecord *next();
+};
+
+/**
+ * Log of the LDMaps received over serial, enabled by telemetry.ldmap_file
+ * in the config file
+ */
+class LDMapLog : public MappedLog
+{
+public:
+    LDMapLog(std::string config_path);
+
+    void append(const LDMap &ldmap, int64_t time_ns);
+};
+
+/**
+ * Read-only view of a mapped log, usable while it is still being written
+ */
+class MappedLogReader
+{
+public:
+    MappedLogReader(const std::string &path, const char *magic, uint32_t record_size);
+    virtual ~MappedLogReader();
+
+    bool isOpen() const;
+    uint64_t size() const;
+
+protected:
+    const void *at(uint64_t i) const;
+
+private:
+    uint32_t record_size;
+    int fd = -1;
+    size_t mapped_size = 0;
+    const TelemetryHeader *header = nullptr;
+    const char *records = nullptr;
+};
+
+class TelemetryReader : public MappedLogReader
+{
+public:
+    TelemetryReader(const std::string &path);
+
+    const TelemetryRecord& operator[](uint64_t i) const;
+};
+
+class LDMapReader : public MappedLogReader
+{
+public:
+    LDMapReader(const std::string &path);
+
+    const LDMapRecord& operator[](uint64_t i) const;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * telemetry_csv.cpp
+ * Converts a telemetry log written by detect into CSV, one row per frame.
+ *
+ * Usage: telemetry_csv <log file> [csv file]
+ */
+
+using namespace std;
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <iomanip>
+
+#include "telemetry.h"
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        cout << "Usage: " << argv[0] << " <log file> [csv file]" << endl;
+        return 0;
+    }
+
+    TelemetryReader log(argv[1]);
+    if (!log.isOpen()) return 1;
+
+    ofstream file;
+    if (argc > 2)
+    {
+        file.open(argv[2]);
+        if (!file)
+        {
+            cerr << "Could not write " << argv[2] << endl;
+            return 1;
+        }
+    }
+    ostream &out = argc > 2 ? file : cout;
+    out << setprecision(17);
+
+    // As many coefficient columns as the widest record needs
+    int degree = 0;
+    for (uint64_t i = 0; i < log.size(); i++)
+    {
+        degree = std::max(degree, (int)log[i].degree);
+    }
+    degree = std::min(degree, LANE_MAX_DEGREE);
+
+    out << "frame,time_ns,steady_ns,degree,hits_left,hits_right,window_left,window_right,pixel_reads,confidence_left,confidence_right";
+    for (const char *name : {"left", "right", "center"})
+    {
+        for (int k = 0; k < degree; k++) out << "," << name << k;
+    }
+    out << ",radius,pid,command_sent,max_time,speed,orientation,distance,dir" << endl;
+
+    for (uint64_t i = 0; i < log.size(); i++)
+    {
+        const TelemetryRecord &r = log[i];
+        out << r.frame << "," << r.time_ns << "," << r.steady_ns << "," << r.degree << "," << r.hits_left << "," << r.hits_right
+            << "," << r.window_left << "," << r.window_right << "," << r.pixel_reads
+            << "," << r.confidence_left << "," << r.confidence_right;
+        for (const double *params : {r.left, r.right, r.center})
+        {
+            for (int k = 0; k < degree; k++) out << "," << params[k];
+        }
+        out << "," << r.radius << "," << r.pid << "," << r.command_sent;
+        if (r.command_sent)
+        {
+            out << "," << r.command.maxTime << "," << r.command.speed << "," << r.command.orientation
+                << "," << r.command.distance << "," << (int)r.command.dir;
+        }
+        else
+        {
+            out << ",,,,,";
+        }
+        out << endl;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+ * Wait-free single-writer single-reader "latest value" cell.
+ *
+ * The writer fills its private buffer and swaps it with the shared middle
+ * one; the reader swaps the middle buffer for its own only when something new
+ * was published. Neither side ever waits or retries, and the reader always
+ * sees a complete value. Values published between two reads are skipped.
+ */
+template <typename T>
+class TripleBuffer
+{
+private:
+    static const int DIRTY = 4; // set in middle when it holds an unread value
+
+    // Padded so writer and reader state sit on different cache lines
+    T buffers[3];
+    char pad0[64];
+    std::atomic<int> middle;
+    char pad1[64];
+    int back;   // writer's buffer
+    char pad2[64];
+    int front;  // reader's buffer
+    bool valid; // reader has taken at least one value
+
+public:
+    TripleBuffer() : buffers(), middle(1), back(2), front(0), valid(false) {}
+
+    /**
+     * Publishes a value. Writer thread only.
+     */
+    void write(const T &value)
+    {
+        buffers[back] = value;
+        back = middle.exchange(back | DIRTY, std::memory_order_acq_rel) & 3;
+    }
+
+    /**
+     * Gets the newest published value. Reader thread only.
+     * @return false if nothing was published yet
+     */
+    bool read(T &value)
+    {
+        if (middle.load(std::memory_order_relaxed) & DIRTY)
+        {
+            front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+            valid = true;
+        }
+        if (!valid) return false;
+        value = buffers[front];
+        return true;
+    }
+};
+
+#endif
@@ -4,23 +4,137 @@
 using namespace std;
 using namespace boost;
 
-#define UART_FIRST_BYTE  'C'
-#define UART_SECOND_BYTE  'O'
+#define LDMAP_QUEUE 256 // decoded LDMaps waiting for the callback thread
 
 
 
 
+//-----COMMAND MAILBOX-----//
+
+CommandMailbox::CommandMailbox()
+{
+    for (Slot &slot : slots)
+    {
+        slot.full = false;
+    }
+    stats = Stats{0, 0, 0, 0, 0};
+}
+
+/**
+ * Stores a command, replacing a pending one of the same kind
+ * @param command command to send
+ * @param kind command stream, 0..COMMAND_KINDS-1
+ * @param coalesced set to true if a pending command was replaced
+ * @param created time the command was produced, for expiry and ordering
+ * @return false if kind is out of range; the command is counted as rejected
+ *         and not stored
+ */
+bool CommandMailbox::post(const UARTCommand &command, int kind, bool &coalesced, Clock::time_point created)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    coalesced = false;
+    if (kind < 0 || kind >= COMMAND_KINDS)
+    {
+        stats.rejected++;
+        return false;
+    }
+
+    Slot &slot = slots[kind];
+    coalesced = slot.full;
+    slot.full = true;
+    slot.command = command;
+    slot.created = created;
+
+    stats.posted++;
+    if (coalesced) stats.coalesced++;
+    return true;
+}
+
+/**
+ * Removes the oldest pending command that has not expired. Expired commands
+ * found on the way are dropped.
+ * @param command destination for the command
+ * @param created destination for its creation time
+ * @param expired set to the number of commands dropped by this call
+ * @param now current time
+ * @return false if nothing is left to send
+ */
+bool CommandMailbox::take(UARTCommand &command, Clock::time_point &created, int &expired, Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    expired = 0;
+    Slot *oldest = nullptr;
+    for (Slot &slot : slots)
+    {
+        if (!slot.full) continue;
+        if (slot.command.maxTime > 0 && now - slot.created > std::chrono::milliseconds(slot.command.maxTime))
+        {
+            slot.full = false;
+            expired++;
+            continue;
+        }
+        if (oldest == nullptr || slot.created < oldest->created)
+        {
+            oldest = &slot;
+        }
+    }
+    stats.expired += expired;
+    if (oldest == nullptr) return false;
+
+    oldest->full = false;
+    command = oldest->command;
+    created = oldest->created;
+    return true;
+}
+
+/**
+ * Counts a command taken earlier as written to the link
+ */
+void CommandMailbox::confirmSent()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.sent++;
+}
+
+int CommandMailbox::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int count = 0;
+    for (const Slot &slot : slots)
+    {
+        count += slot.full;
+    }
+    return count;
+}
+
+CommandMailbox::Stats CommandMailbox::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+//-----SERIAL COMMUNICATION-----//
+
 SerialCommunication::SerialCommunication(const std::string& devname, unsigned int baud_rate,
         asio::serial_port_base::parity opt_parity,
         asio::serial_port_base::character_size opt_csize,
         asio::serial_port_base::flow_control opt_flow,
-        asio::serial_port_base::stop_bits opt_stop) : port(io)
+        asio::serial_port_base::stop_bits opt_stop) : port(io),
+        received(LDMAP_QUEUE),
+        wireLatency(Metrics::instance().histogram("serial.enqueue_to_wire_ns")),
+        commandsSent(Metrics::instance().counter("serial.commands_sent")),
+        commandsCoalesced(Metrics::instance().counter("serial.commands_coalesced")),
+        commandsExpired(Metrics::instance().counter("serial.commands_expired")),
+        commandsRejected(Metrics::instance().counter("serial.commands_rejected")),
+        ldmapReceived(Metrics::instance().counter("serial.ldmap_received")),
+        ldmapDropped(Metrics::instance().counter("serial.ldmap_dropped")),
+        ldmapErrors(Metrics::instance().counter("serial.ldmap_checksum_errors"))
 {
-     ch = 0;
-     rxUartState = UartWaitForFirstStart;
      openPort = false;
-     iByte = 0;
+     writing = false;
      serialExecution = NULL;
+     callbackExecution = NULL;
+     running = false;
 
      open(devname,baud_rate,opt_parity,opt_csize,opt_flow,opt_stop);
 }
@@ -28,16 +142,40 @@ SerialCommunication::SerialCommunication(const std::string& devname, unsigned in
 
 SerialCommunication::~SerialCommunication()
 {
-      if(!isOpen()) return;    
-	port.close();
+    io.stop();
+    running = false;
+    for (std::thread *thread : {serialExecution, callbackExecution})
+    {
+        if (thread != NULL && thread->joinable())
+        {
+            thread->join();
+        }
+        delete thread;
+    }
 
+    if(!isOpen()) return;    
+    port.close();
 }
 
+/**
+ * Adds a callback for every received LDMap. Callbacks run on their own
+ * thread, so a slow one delays other callbacks but never reception.
+ * Register before run().
+ */
 void SerialCommunication::register_callback(std::function<void(const LDMap&)> callback)
 {
     callbacks.push_back(callback);
 }
 
+/**
+ * Gets the most recently received LDMap without waiting. Call from one thread only.
+ * @return false if none has been received yet
+ */
+bool SerialCommunication::getLatest(LDMap &ldmap)
+{
+    return latest.read(ldmap);
+}
+
 void SerialCommunication::open(const std::string& devname, unsigned int baud_rate,
         asio::serial_port_base::parity opt_parity,
         asio::serial_port_base::character_size opt_csize,
@@ -63,115 +201,124 @@ bool SerialCommunication::isOpen() const
     return openPort;
 }
 
-void SerialCommunication::sendCommand(UARTCommand uartCommand)
+/**
+ * Hands a command to the io_service thread. Never blocks on the port. A
+ * command of the same kind that has not been sent yet is replaced.
+ * @param uartCommand command to send
+ * @param kind command stream, 0 to COMMAND_KINDS-1
+ * @return false if kind is out of range and the command was dropped
+ */
+bool SerialCommunication::sendCommand(UARTCommand uartCommand, int kind)
+{
+    bool coalesced;
+    if (!mailbox.post(uartCommand, kind, coalesced))
+    {
+        commandsRejected.add();
+        return false;
+    }
+    if (coalesced)
+    {
+        commandsCoalesced.add();
+    }
+    io.post([this]() { startWrite(); });
+    return true;
+}
+
+CommandMailbox::Stats SerialCommunication::getCommandStats() const
 {
-    mutex.lock();
-     queue.push(uartCommand);
-     mutex.unlock();
+    return mailbox.getStats();
 }
 
-void SerialCommunication::receiveData(unsigned char c)
+/**
+ * Builds a command frame in the preallocated transmit buffer:
+ * 'C' 'O' size payload checksum '\r' '\n'
+ * @return frame length
+ */
+std::size_t SerialCommunication::frameCommand(const unsigned char *data, unsigned char size)
 {
-	if (isprint(c) || c == '\n') 
+    uint8_t *out = txFrame.data();
+    *out++ = UART_FIRST_BYTE;
+    *out++ = UART_SECOND_BYTE;
+    *out++ = size;
+
+    unsigned char ch = 0;
+    for (int i=0; i<size; i++)
     {
-	  // printf("%c", c);
+        ch += data[i];
+        *out++ = data[i];
     }
-        switch (rxUartState)
+    *out++ = ch;
+    *out++ = '\r';
+    *out++ = '\n';
+    return out - txFrame.data();
+}
+
+/**
+ * Sends the oldest queued command with a single asynchronous write, unless a
+ * write is already in flight. Runs on the io_service thread.
+ */
+void SerialCommunication::startWrite()
+{
+    if (writing) return;
+
+    UARTCommand command;
+    int expired = 0;
+    bool ready = mailbox.take(command, writeEnqueued, expired);
+    commandsExpired.add(expired);
+    if (!ready) return;
+
+    std::size_t size = frameCommand((const unsigned char *)&command, sizeof(UARTCommand));
+    writing = true;
+    asio::async_write(port, asio::buffer(txFrame.data(), size),
+        [this](const boost::system::error_code &error, std::size_t)
         {
-            case UartWaitForFirstStart:
-                if (c == UART_FIRST_BYTE)
-                {
-                    
-                    rxUartState = UartWaitForSecondStart;
-         		    // printf("UART_FIRST_BYTE\n");
-                }
-                break;
-            case UartWaitForSecondStart:
-                if (c == UART_SECOND_BYTE)
-                {
-                    // printf("UART_SECOND_BYTE\n");
-                    rxUartState = UartWaitForLenght;
-                }
-                else
-                {
-                    rxUartState = UartWaitForFirstStart;
-        		    // printf("UART_FIRST_BYTE\n");
-                }
-                break;
-            case UartWaitForLenght:
-                if (sizeof(LDMap) == c)
-                {
-                    ch = 0;
-                    lenght = c;
-                    iByte = 0;
-                    rxUartState = UartWaitForData;
-		            // printf("uartData %d\n", lenght);
-                }
-                else
-                {
-                    rxUartState = UartWaitForFirstStart;
-        		    // printf("UART_FIRST_BYTE\n");
-                }
-                break;
-            case UartWaitForData:
-                if (iByte < lenght)
-                {
-                    // printf("data %d %d\n", iByte, c);
-                    ch += c;
-                    buffer[iByte++] = c;
-                }
-                if (iByte == lenght)
-                {
-                    rxUartState = UartWaitForCheckSum;
-		            // printf("UartWaitForCheckSum\n");
-                }
-                break;
-            case UartWaitForCheckSum:
-                // accept if the calculated ch is equal to c
-	            // printf("Checksum %d %d\n", ch, c);
-                if (ch == c)
-                {
-                    LDMap ldmap;
-                    memcpy(&ldmap, buffer, sizeof(LDMap));
-
-                    for (const auto &callback : callbacks)
-                    {
-                        callback(ldmap);
-                    }
-                    // printf("\033[2J");
-                    // printf("\033[H");
-                    // printf("%d Pos (%d,%d,%d), \nSpeed (%d,%d,%d), \nAcc (%d,%d,%d)\nheading %d\n Members %d, distance %d, timestamp %d \n", 
-                    // ldmap.id, ldmap.position_x, ldmap.position_y, ldmap.position_z,
-                    // ldmap.speed_x, ldmap.speed_y, ldmap.speed_z, ldmap.acceleration_x, ldmap.acceleration_y,
-                    // ldmap.acceleration_z, ldmap.orientation, ldmap.members, ldmap.distance, ldmap.timestamp);
-                    
-                }
-                rxUartState = UartWaitForFirstStart;
-                break;
-        }
+            writing = false;
+            if (error) return;
+
+            mailbox.confirmSent();
+            commandsSent.add();
+            if (Metrics::enabled())
+            {
+                wireLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - writeEnqueued).count());
+            }
+            startWrite();
+        });
 }
 
-      
-void SerialCommunication::writeCommand(unsigned char *data, unsigned char size)
+/**
+ * Reads whatever bytes are available and feeds them to the frame parser,
+ * then rearms itself. Runs on the io_service thread.
+ */
+void SerialCommunication::startRead()
 {
-  
-    unsigned char buff[3] = {UART_FIRST_BYTE, UART_SECOND_BYTE, size};
-    boost::asio::write(port, boost::asio::buffer(buff, 3));
-    boost::asio::write(port, boost::asio::buffer(data, size));
-    unsigned ch = 0;
-    for (int i=0; i<size; i++, data++)
-    {
-	ch = (ch + *data) % 256;
-    }
-    buff[0] = ch;
-    buff[1] = '\r';
-    buff[2] = '\n'; 
-    boost::asio::write(port, boost::asio::buffer(&ch, 1));
-    boost::asio::write(port, boost::asio::buffer(&buff[0], 1));
-    boost::asio::write(port, boost::asio::buffer(&buff[1], 1));
+    port.async_read_some(asio::buffer(rxBuffer),
+        [this](const boost::system::error_code &error, std::size_t size)
+        {
+            if (error)
+            {
+                if (error != asio::error::operation_aborted)
+                {
+                    std::cerr << "Serial read failed: " << error.message() << std::endl;
+                }
+                return;
+            }
 
-    
-//      printf("Sending %d\n", ch);
+            uint64_t errors = parser.getStats().checksum_errors;
+            decoded.clear();
+            parser.parse(rxBuffer.data(), size, decoded);
+            ldmapErrors.add(parser.getStats().checksum_errors - errors);
+            ldmapReceived.add(decoded.size());
+
+            for (const LDMap &ldmap : decoded)
+            {
+                latest.write(ldmap);
+                if (!callbacks.empty() && !received.push(ldmap))
+                {
+                    ldmapDropped.add();
+                }
+            }
+            startRead();
+        });
 }
 
 void serialTask(SerialCommunication *serial)
@@ -186,38 +333,40 @@ void SerialCommunication::join()
 
 void SerialCommunication::run()
 {
+     running = true;
      serialExecution = new std::thread(serialTask, this); 
+     callbackExecution = new std::thread(&SerialCommunication::dispatch, this);
 }
 
+/**
+ * Hands received LDMaps to the registered callbacks
+ */
+void SerialCommunication::dispatch()
+{
+    LDMap ldmap;
+    while (running)
+    {
+        if (!received.pop(ldmap))
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        for (const auto &callback : callbacks)
+        {
+            callback(ldmap);
+        }
+    }
+}
+
+/**
+ * Runs the io_service: reads and writes proceed independently, so commands
+ * never wait for inbound data. Returns once the object is destroyed.
+ */
 void SerialCommunication::execute()
 {
-      uint8_t i;
-      unsigned char bufffer[sizeof(LDMap)+5];
-      memset(bufffer, 0, sizeof(LDMap)+5);
-      while(true)
-      {
-	  mutex.lock();
-	  if (queue.size() > 0)
-	  {
-	      UARTCommand command = queue.front();
-	      writeCommand((unsigned char *)&command, sizeof(UARTCommand));
-	      queue.pop();
-	  }
-	  mutex.unlock();
-	  std::size_t size = boost::asio::read(port, boost::asio::buffer(bufffer, sizeof(LDMap)+5));
-// 	  	  std::size_t size = boost::asio::read(port, boost::asio::buffer(bufffer, 8));
-
-//  	printf("Size %d\n", (int)size);
-	 
-	  for (i=0; i<size; i++)
-	  {
-		
-//  		printf("Byte %d\n", bufffer[i]);
-	      receiveData(bufffer[i]);
-	  }
-	      
-	  memset(bufffer, 0, sizeof(LDMap)+5);
-      }
-}
-      
+    startRead();
+    startWrite();
 
+    asio::io_service::work work(io);
+    io.run();
+}
@@ -2,13 +2,21 @@
 #define _UARTCOMMANDER_H_
 
 #include <iostream>
-#include <queue>
 #include <thread>
 #include <mutex>
+#include <chrono>
+#include <array>
+#include <atomic>
+#include <functional>
 
 #include <vector>
 #include <boost/asio.hpp>
 
+#include "metrics.h"
+#include "ldmap.h"
+#include "spsc.h"
+#include "triplebuffer.h"
+
 
 
 using namespace std;
@@ -24,23 +32,54 @@ typedef struct _tUARTCommand
 } UARTCommand;
 
 
-typedef struct _LDMap
-{
-   uint8_t id;
-   uint8_t leaderId;
-   int8_t position_x,position_y,position_z; // decimenter 
-   int8_t speed_x,  speed_y, speed_z;   // cm per second
-   int8_t acceleration_x,acceleration_y,acceleration_z; // cm per second square
-   int16_t orientation;
-   uint16_t members;
-   int16_t distance;
-   uint32_t timestamp;
-} LDMap;
 
 
+#define COMMAND_KINDS 4 // independent command streams kept by CommandMailbox
+
 
-enum {UartWaitForFirstStart, UartWaitForSecondStart,
-      UartWaitForLenght, UartWaitForData, UartWaitForCheckSum};
+/**
+ * Bounded, latest-wins channel for commands waiting to go out on the link.
+ *
+ * Holds at most one pending command per kind: posting replaces a pending
+ * command of the same kind (coalesced). Commands are stamped when posted and
+ * dropped instead of sent once they are older than their maxTime in
+ * milliseconds (expired; maxTime <= 0 never expires). Among kinds, the
+ * oldest pending command is sent first.
+ */
+class CommandMailbox
+{
+    public:
+      typedef std::chrono::steady_clock Clock;
+
+      struct Stats
+      {
+          uint64_t posted;    // commands handed to post()
+          uint64_t coalesced; // pending commands replaced by a newer one of the same kind
+          uint64_t expired;   // commands dropped for being older than maxTime
+          uint64_t sent;      // commands confirmed on the wire
+          uint64_t rejected;  // commands not stored because their kind was out of range
+      };
+
+      CommandMailbox();
+
+      bool post(const UARTCommand &command, int kind, bool &coalesced, Clock::time_point created = Clock::now());
+      bool take(UARTCommand &command, Clock::time_point &created, int &expired, Clock::time_point now = Clock::now());
+      void confirmSent();
+      int pending() const;
+      Stats getStats() const;
+
+    private:
+      struct Slot
+      {
+          bool full;
+          UARTCommand command;
+          Clock::time_point created;
+      };
+
+      Slot slots[COMMAND_KINDS];
+      Stats stats;
+      mutable std::mutex mutex;
+};
 
 
 class SerialCommunication
@@ -56,10 +95,12 @@ class SerialCommunication
       
       ~SerialCommunication();
       
-      void sendCommand(UARTCommand uartCommand);
+      bool sendCommand(UARTCommand uartCommand, int kind = 0);
+      CommandMailbox::Stats getCommandStats() const;
       bool isOpen() const;
       void execute();
       void register_callback(std::function<void(const LDMap&)>);
+      bool getLatest(LDMap &ldmap);
       
       void run();
       void join();
@@ -78,24 +119,46 @@ private:
             asio::serial_port_base::stop_bits(
                 asio::serial_port_base::stop_bits::one));
 
-      void receiveData(unsigned char c);
-      void writeCommand(unsigned char *data, unsigned char size);
+      typedef std::chrono::steady_clock Clock;
+
+      // Header (2 start bytes, length), payload, checksum, "\r\n"
+      static const std::size_t FRAME_SIZE = 3 + sizeof(UARTCommand) + 3;
+
+      void dispatch();
+      std::size_t frameCommand(const unsigned char *data, unsigned char size);
+      void startRead();
+      void startWrite();
 
     
-      std::queue<UARTCommand> queue;
+      CommandMailbox mailbox;
       asio::io_service io;
       asio::serial_port port;
       bool openPort;
-      
-      uint8_t rxUartState;
-      uint8_t buffer[sizeof(LDMap)+1];
-      uint8_t ch;
-      uint8_t lenght;
-      uint8_t iByte;
+
+      // Only touched by handlers running on the io_service thread
+      std::array<uint8_t, FRAME_SIZE> txFrame;
+      std::array<uint8_t, 4096> rxBuffer;
+      bool writing;
+      Clock::time_point writeEnqueued;
+      LDMapParser parser;
+      std::vector<LDMap> decoded;
+
+      SpscQueue<LDMap> received;   // io_service thread -> callback thread
+      TripleBuffer<LDMap> latest;  // io_service thread -> getLatest()
       std::vector<std::function<void(LDMap&)>> callbacks;
       
       std::thread *serialExecution;
-      std::mutex mutex;
+      std::thread *callbackExecution;
+      std::atomic<bool> running;
+
+      Histogram &wireLatency;
+      Counter &commandsSent;
+      Counter &commandsCoalesced;
+      Counter &commandsExpired;
+      Counter &commandsRejected;
+      Counter &ldmapReceived;
+      Counter &ldmapDropped;
+      Counter &ldmapErrors;
 };
 
 